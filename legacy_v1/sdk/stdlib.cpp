@@ -9,111 +9,82 @@
 // Syscall Wrappers
 // =============================================================================
 
+// SYSENTER where the kernel turns it on (CPUID SEP, minus the Pentium Pro,
+// whose SEP bit lies), int 0x80 otherwise. SYSEXIT comes back through
+// ECX/EDX, so our stack goes in EBP with the resume address on top.
+// Probed once, on first use.
+static int sysenter = -1;
+
+static bool HasSysenter() {
+    if (sysenter < 0) {
+        unsigned int a, b, c, d;
+        asm volatile("cpuid" : "=a"(a), "=b"(b), "=c"(c), "=d"(d) : "a"(1));
+        unsigned int family = (a >> 8) & 0xF, model = (a >> 4) & 0xF, stepping = a & 0xF;
+        sysenter = (d & (1u << 11)) && (d & (1u << 5)) && !(family == 6 && model < 3 && stepping < 3);
+    }
+    return sysenter;
+}
+
+// EAX = number, EBX/ECX/EDX/ESI = arguments, result in EAX
+static int syscall(int num, int a1 = 0, int a2 = 0, int a3 = 0, int a4 = 0) {
+    int ret;
+    if (HasSysenter()) {
+        asm volatile("push %%ebp\n"
+                     "push $1f\n"
+                     "mov %%esp, %%ebp\n"
+                     "sysenter\n"
+                     "1: pop %%ebp"
+                     : "=a"(ret), "+c"(a2), "+d"(a3) : "a"(num), "b"(a1), "S"(a4) : "memory", "cc");
+    } else {
+        asm volatile("int $0x80" : "=a"(ret) : "a"(num), "b"(a1), "c"(a2), "d"(a3), "S"(a4) : "memory");
+    }
+    return ret;
+}
+
 void exit(int code) {
-    asm volatile(
-        "mov $1, %%eax;"
-        "mov %0, %%ebx;"
-        "int $0x80"
-        : 
-        : "r"(code) 
-        : "eax", "ebx"
-    );
+    syscall(SYS_EXIT, code);
     // Never returns
     while(1) {}
 }
 
 void printf(const char* str) {
-    asm volatile(
-        "mov $2, %%eax;"
-        "mov %0, %%ebx;"
-        "int $0x80"
-        : 
-        : "r"(str) 
-        : "eax", "ebx"
-    );
+    syscall(SYS_PRINT, (int)str);
 }
 
 int read(char* buffer, int size) {
-    int ret;
-    asm volatile(
-        "int $0x80"
-        : "=a"(ret)
-        : "a"(3), "b"(buffer), "c"(size)
-    );
-    return ret;
+    return syscall(SYS_READ, (int)buffer, size);
 }
 
 int exec(const char* filename) {
-    int ret;
-    asm volatile(
-        "mov $4, %%eax;"
-        "mov %1, %%ebx;"
-        "int $0x80"
-        : "=a"(ret)
-        : "r"(filename) 
-        : "ebx"
-    );
-    return ret; // Only returns on failure
+    return syscall(SYS_EXEC, (int)filename); // Only returns on failure
 }
 
 void clear_screen() {
-    asm volatile(
-        "mov $5, %%eax;"
-        "int $0x80"
-        : 
-        : 
-        : "eax"
-    );
+    syscall(SYS_CLEAR);
 }
 
 void list_dir(char* buffer, int size) {
-    asm volatile(
-        "int $0x80"
-        : 
-        : "a"(6), "b"(buffer), "c"(size)
-        : "memory"
-    );
+    syscall(SYS_LIST, (int)buffer, size);
 }
 
 int spawn(const char* filename) {
-    int ret;
-    asm volatile(
-        "int $0x80"
-        : "=a"(ret)
-        : "a"(7), "b"(filename)
-        : "memory"
-    );
-    return ret;
+    return syscall(SYS_SPAWN, (int)filename);
 }
 
 int open_window(int w, int h, const char* title) {
-    int ret;
-    asm volatile(
-        "int $0x80"
-        : "=a"(ret)
-        : "a"(8), "b"(w), "c"(h), "d"(title)
-    );
-    return ret;
+    return syscall(SYS_OPEN_WIN, w, h, (int)title);
 }
 
 void win_draw_rect(int id, int x, int y, int w, int h, int col) {
     // Pack x|y and w|h into registers
     int xy = (x << 16) | (y & 0xFFFF);
     int wh = (w << 16) | (h & 0xFFFF);
-    asm volatile(
-        "int $0x80"
-        :
-        : "a"(9), "b"(id), "c"(xy), "d"(wh), "S"(col)
-    );
+    syscall(SYS_WIN_DRAW, id, xy, wh, col);
 }
 
 void win_draw_text(int id, int x, int y, const char* str, int col) {
     int xy = (x << 16) | (y & 0xFFFF);
-    asm volatile(
-        "int $0x80"
-        :
-        : "a"(10), "b"(id), "c"(xy), "d"(str), "S"(col)
-    );
+    syscall(SYS_WIN_TEXT, id, xy, (int)str, col);
 }
 
 // =============================================================================
@@ -134,20 +105,43 @@ int strlen(const char* str) {
     return len;
 }
 
-void* memset(void* dest, int val, size_t count) {
-    char* temp = (char*)dest;
-    for (size_t i = 0; i < count; i++) {
-        temp[i] = (char)val;
+// String instructions instead of byte loops. CPUs with ERMS (CPUID leaf 7,
+// EBX bit 9) make "rep movsb" the fastest copy at any size; otherwise move
+// dwords and finish the tail bytewise. Probed once, on first use.
+static int erms = -1;
+
+static bool HasErms() {
+    if (erms < 0) {
+        unsigned int max_leaf, a, b, c, d;
+        asm volatile("cpuid" : "=a"(max_leaf), "=b"(b), "=c"(c), "=d"(d) : "a"(0));
+        erms = 0;
+        if (max_leaf >= 7) {
+            asm volatile("cpuid" : "=a"(a), "=b"(b), "=c"(c), "=d"(d) : "a"(7), "c"(0));
+            erms = (b >> 9) & 1;
+        }
     }
+    return erms;
+}
+
+void* memset(void* dest, int val, size_t count) {
+    unsigned char* dp = (unsigned char*)dest;
+    unsigned int pattern = (unsigned char)val * 0x01010101u;
+    size_t dwords = count / 4, bytes = count & 3;
+    asm volatile("cld; rep stosl" : "+D"(dp), "+c"(dwords) : "a"(pattern) : "memory");
+    asm volatile("rep stosb" : "+D"(dp), "+c"(bytes) : "a"(pattern) : "memory");
     return dest;
 }
 
 void* memcpy(void* dest, const void* src, size_t count) {
-    const char* sp = (const char*)src;
-    char* dp = (char*)dest;
-    for (size_t i = 0; i < count; i++) {
-        dp[i] = sp[i];
+    unsigned char* dp = (unsigned char*)dest;
+    const unsigned char* sp = (const unsigned char*)src;
+    if (HasErms()) {
+        asm volatile("cld; rep movsb" : "+D"(dp), "+S"(sp), "+c"(count) : : "memory");
+        return dest;
     }
+    size_t dwords = count / 4, bytes = count & 3;
+    asm volatile("cld; rep movsl" : "+D"(dp), "+S"(sp), "+c"(dwords) : : "memory");
+    asm volatile("rep movsb" : "+D"(dp), "+S"(sp), "+c"(bytes) : : "memory");
     return dest;
 }
 
@@ -170,16 +164,7 @@ char* strcat(char* dest, const char* src) {
 
 // sbrk wrapper
 void* sbrk(int incr) {
-    void* ret;
-    asm volatile(
-        "mov $11, %%eax;"
-        "mov %1, %%ebx;"
-        "int $0x80"
-        : "=a"(ret) 
-        : "r"(incr) 
-        : "ebx"
-    );
-    return ret;
+    return (void*)syscall(SYS_SBRK, incr);
 }
 
 struct BlockHeader {
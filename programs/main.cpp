@@ -1,55 +1,86 @@
 #include <stdint.h>
 #include <stddef.h>
+#include "malloc.h"
+#include "stdio.h"
+#include "sysinfo.h"
 
 // --- Syscalls ---
+// SYSENTER where the kernel turns it on (CPUID SEP, minus the Pentium Pro,
+// whose SEP bit lies), int 0x80 otherwise. SYSEXIT comes back through
+// ECX/EDX, so our stack goes in EBP with the resume address on top.
+static int sysenter = -1;
+
+static bool HasSysenter() {
+    if (sysenter < 0) {
+        unsigned int a, b, c, d;
+        asm volatile("cpuid" : "=a"(a), "=b"(b), "=c"(c), "=d"(d) : "a"(1));
+        unsigned int family = (a >> 8) & 0xF, model = (a >> 4) & 0xF, stepping = a & 0xF;
+        sysenter = (d & (1u << 11)) && (d & (1u << 5)) && !(family == 6 && model < 3 && stepping < 3);
+    }
+    return sysenter;
+}
+
 extern "C" int syscall(int num, int a1, int a2, int a3) {
     int ret;
-    asm volatile("int $0x80" : "=a"(ret) : "a"(num), "b"(a1), "c"(a2), "d"(a3));
+    if (HasSysenter()) {
+        asm volatile("push %%ebp\n"
+                     "push $1f\n"
+                     "mov %%esp, %%ebp\n"
+                     "sysenter\n"
+                     "1: pop %%ebp"
+                     : "=a"(ret), "+c"(a2), "+d"(a3) : "a"(num), "b"(a1) : "memory", "cc");
+    } else {
+        asm volatile("int $0x80" : "=a"(ret) : "a"(num), "b"(a1), "c"(a2), "d"(a3) : "memory");
+    }
     return ret;
 }
 
-// --- User Space Memory Manager (malloc) ---
-void* sbrk(int incr) {
-    return (void*)syscall(45, incr, 0, 0);
+// --- Time ---
+// Read from the kernel's shared page, no syscall: the last tick's clock
+// plus the TSC cycles since (syscall 265 if the page isn't there)
+struct timespec { uint32_t tv_sec; uint32_t tv_nsec; };
+#define CLOCK_REALTIME  0
+#define CLOCK_MONOTONIC 1
+
+static inline uint64_t rdtsc() {
+    uint64_t v;
+    asm volatile("rdtsc" : "=A"(v));
+    return v;
 }
 
-struct BlockHeader {
-    size_t size;
-    bool is_free;
-    BlockHeader* next;
-};
+// ns / 10^9 in one DIV (no libgcc): fine until the quotient passes 2^32 s
+static void SplitNs(uint64_t ns, timespec* ts) {
+    asm("divl %4" : "=a"(ts->tv_sec), "=d"(ts->tv_nsec)
+                  : "a"((uint32_t)ns), "d"((uint32_t)(ns >> 32)), "rm"(1000000000u));
+}
 
-BlockHeader* heap_head = 0;
+int clock_gettime(int clock, timespec* ts) {
+    // Always mapped (no process starts without it); a layout we don't know
+    // goes through the syscall instead
+    if (sysinfo->version != SYSINFO_VERSION) return syscall(265, clock, (int)ts, 0);
+    if (clock != CLOCK_REALTIME && clock != CLOCK_MONOTONIC) return -22; // EINVAL
 
-void* malloc(size_t size) {
-    // 1. Search for free block
-    BlockHeader* curr = heap_head;
-    while (curr) {
-        if (curr->is_free && curr->size >= size) {
-            curr->is_free = false;
-            return (void*)(curr + 1);
+    uint32_t seq, boot;
+    uint64_t ns;
+    do {
+        seq = sysinfo->seq;
+        asm volatile("" : : : "memory");
+        ns = sysinfo->mono_ns;
+        if (sysinfo->tsc) {
+            uint64_t cycles = rdtsc() - sysinfo->tsc;
+            if ((int64_t)cycles < 0) cycles = 0;         // Another CPU's TSC, a hair behind
+            if (cycles > 0xFFFFFFFF) cycles = 0xFFFFFFFF; // Ticks come far more often
+            uint32_t c = (uint32_t)cycles;
+            ns += (uint64_t)c * (uint32_t)(sysinfo->ns_per_cycle >> 32)
+                + (((uint64_t)c * (uint32_t)sysinfo->ns_per_cycle) >> 32);
         }
-        curr = curr->next;
-    }
-
-    // 2. Request from Kernel
-    size_t total_size = sizeof(BlockHeader) + size;
-    BlockHeader* new_block = (BlockHeader*)sbrk(total_size);
-    
-    if ((uint32_t)new_block == 0) return 0; // OOM
+        boot = sysinfo->boot_time;
+        asm volatile("" : : : "memory");
+    } while ((seq & 1) || seq != sysinfo->seq);
 
-    new_block->size = size;
-    new_block->is_free = false;
-    new_block->next = heap_head; // Insert at front (simple)
-    heap_head = new_block;
-
-    return (void*)(new_block + 1);
-}
-
-void free(void* ptr) {
-    if (!ptr) return;
-    BlockHeader* block = (BlockHeader*)ptr - 1;
-    block->is_free = true;
+    SplitNs(ns, ts);
+    if (clock == CLOCK_REALTIME) ts->tv_sec += boot;
+    return 0;
 }
 
 // --- C++ Operators ---
@@ -61,9 +92,20 @@ void operator delete[](void* p) { free(p); }
 
 // --- Utils ---
 int strlen(const char* str) { int l=0; while(str[l])l++; return l; }
-void print(const char* str) { syscall(4, 1, (int)str, strlen(str)); }
-void putc(char c) { syscall(4, 1, (int)&c, 1); }
-char getc() { return (char)syscall(3, 0, 0, 0); }
+int read(int fd, char* buf, int count) { return syscall(3, fd, (int)buf, count); }
+// Keys arrive in bursts: one read() takes everything already typed.
+// Whatever was printed (prompt, echo) is shown before waiting for more.
+char getc() {
+    static char buf[32];
+    static int pos = 0, len = 0;
+    if (pos == len) {
+        flush();
+        len = read(0, buf, sizeof(buf));
+        pos = 0;
+        if (len <= 0) { len = 0; return 0; }
+    }
+    return buf[pos++];
+}
 bool strcmp(const char* a, const char* b) {
     int i=0; while(a[i] && b[i]) { if(a[i]!=b[i]) return false; i++; }
     return a[i]==b[i];
@@ -92,13 +134,51 @@ extern "C" int main() {
             cmd[idx] = 0;
             if (idx > 0) {
                 if (strcmp(cmd, "help")) {
+                    print("  mem     - Heap Statistics\n");
                     print("  reboot  - Restart System (Syscall 88)\n");
+                    print("  date    - Wall Clock, UTC (Shared Page)\n");
+                    print("  uptime  - Time Since Boot (Shared Page)\n");
                     print("  ver     - Show Version\n");
                 }
                 else if (strcmp(cmd, "reboot")) {
                     print("Rebooting...");
+                    flush();
                     syscall(88, 0, 0, 0);
                 }
+                else if (strcmp(cmd, "mem")) {
+                    MallocStats st;
+                    malloc_stats(&st);
+                    print("Heap: "); printu(st.heap_bytes);
+                    print(" bytes, used "); printu(st.used_bytes);
+                    print(", free "); printu(st.free_bytes);
+                    print(" in "); printu(st.free_blocks); print(" blocks\n");
+                    print("Allocs: "); printu(st.allocs);
+                    print(", frees "); printu(st.frees);
+                    print(", sbrk calls "); printu(st.sbrk_calls); print("\n");
+                }
+                else if (strcmp(cmd, "uptime")) {
+                    timespec ts;
+                    if (clock_gettime(CLOCK_MONOTONIC, &ts) == 0) {
+                        uint32_t ms = ts.tv_nsec / 1000000;
+                        print("Up "); printu(ts.tv_sec); print(".");
+                        if (ms < 100) putc('0');
+                        if (ms < 10) putc('0');
+                        printu(ms); print(" s\n");
+                    }
+                }
+                else if (strcmp(cmd, "date")) {
+                    timespec ts;
+                    if (clock_gettime(CLOCK_REALTIME, &ts) == 0) {
+                        uint32_t day = ts.tv_sec % 86400;
+                        uint32_t fields[3] = { day / 3600, day / 60 % 60, day % 60 };
+                        for (int i = 0; i < 3; i++) {
+                            if (i) putc(':');
+                            if (fields[i] < 10) putc('0');
+                            printu(fields[i]);
+                        }
+                        print(" UTC ("); printu(ts.tv_sec); print(" s since 1970)\n");
+                    }
+                }
                 else if (strcmp(cmd, "ver")) print("v0.2 - Heap Enabled\n");
                 else print("Unknown.\n");
             }
@@ -0,0 +1,284 @@
+#include "malloc.h"
+
+extern "C" int syscall(int num, int a1, int a2, int a3);
+
+#define ALIGNMENT      8
+#define HEADER_SIZE    8
+#define MIN_BLOCK      16            // Header + the two free-list links
+#define PAGE_SIZE      4096
+#define MAX_REQUEST    0x7FFFF000
+
+#define GROW_MIN       (16 * 1024)   // First sbrk; doubles on every grow
+#define GROW_MAX       (1024 * 1024)
+#define TRIM_THRESHOLD (256 * 1024)  // Free space at the top worth giving back
+#define TRIM_KEEP      (64 * 1024)   // ...minus this much, for the next burst
+
+// Bins: exact sizes 16..512 in steps of 8, then one per power of two
+#define SMALL_LIMIT    512
+#define SMALL_BINS     ((SMALL_LIMIT - MIN_BLOCK) / ALIGNMENT + 1)
+#define LARGE_BINS     (32 - 9)
+#define NUM_BINS       (SMALL_BINS + LARGE_BINS)
+#define BITMAP_WORDS   ((NUM_BINS + 31) / 32)
+
+#define IN_USE 1
+
+// Every block starts with this header; the links only exist while it is free.
+// The heap always ends with a zero-sized in-use header (the epilogue), so
+// the last real block has a neighbour to check like any other.
+struct Block {
+    uint32_t prev_size; // Size of the block just below (0 = first block)
+    uint32_t size;      // Whole block, header included | IN_USE
+    Block* next;
+    Block* prev;
+};
+
+static Block* bins[NUM_BINS];
+static uint32_t bin_bitmap[BITMAP_WORDS]; // Bit set = bin not empty
+static uint8_t* heap_start = 0;
+static uint8_t* heap_end = 0;
+static uint32_t grow_size = GROW_MIN;
+static MallocStats stats;
+
+static void* sbrk(int incr) {
+    stats.sbrk_calls++;
+    return (void*)syscall(45, incr, 0, 0);
+}
+
+static inline uint32_t SizeOf(Block* b) { return b->size & ~(ALIGNMENT - 1); }
+static inline bool IsFree(Block* b) { return !(b->size & IN_USE); }
+static inline Block* After(Block* b) { return (Block*)((uint8_t*)b + SizeOf(b)); }
+static inline Block* Before(Block* b) { return (Block*)((uint8_t*)b - b->prev_size); }
+static inline Block* Epilogue() { return (Block*)(heap_end - HEADER_SIZE); }
+
+static inline uint32_t Log2(uint32_t v) { return 31 - __builtin_clz(v); }
+
+static int BinIndex(uint32_t size) {
+    if (size <= SMALL_LIMIT) return (size - MIN_BLOCK) / ALIGNMENT;
+    return SMALL_BINS + Log2(size) - 9;
+}
+
+// First non-empty bin at or above 'from' (-1 if none)
+static int NextBin(int from) {
+    for (int w = from / 32; w < BITMAP_WORDS; w++) {
+        uint32_t bits = bin_bitmap[w];
+        if (w == from / 32) bits &= ~0u << (from % 32);
+        if (bits) return w * 32 + __builtin_ctz(bits);
+    }
+    return -1;
+}
+
+static void Insert(Block* b) {
+    int bin = BinIndex(SizeOf(b));
+    b->prev = 0;
+    b->next = bins[bin];
+    if (b->next) b->next->prev = b;
+    bins[bin] = b;
+    bin_bitmap[bin / 32] |= 1u << (bin % 32);
+
+    stats.free_bytes += SizeOf(b);
+    stats.free_blocks++;
+}
+
+static void Unlink(Block* b) {
+    int bin = BinIndex(SizeOf(b));
+    if (b->prev) b->prev->next = b->next;
+    else bins[bin] = b->next;
+    if (b->next) b->next->prev = b->prev;
+    if (!bins[bin]) bin_bitmap[bin / 32] &= ~(1u << (bin % 32));
+
+    stats.free_bytes -= SizeOf(b);
+    stats.free_blocks--;
+}
+
+static void Resize(Block* b, uint32_t size, uint32_t flags) {
+    b->size = size | flags;
+    After(b)->prev_size = size;
+}
+
+// Take a free block of at least 'size' bytes off the lists
+static Block* TakeFit(uint32_t size) {
+    int bin = BinIndex(size);
+    if (bin >= SMALL_BINS) {
+        // Power-of-two classes mix sizes: first fit within our own class
+        for (Block* b = bins[bin]; b; b = b->next) {
+            if (SizeOf(b) >= size) { Unlink(b); return b; }
+        }
+        bin++;
+    }
+    // Anything in the exact small bin or a higher class is big enough
+    if (bin >= NUM_BINS) return 0;
+    bin = NextBin(bin);
+    if (bin < 0) return 0;
+    Block* b = bins[bin];
+    Unlink(b);
+    return b;
+}
+
+// Mark 'b' in use at 'size' bytes; a big enough tail goes back on the lists
+static void Split(Block* b, uint32_t size) {
+    uint32_t rest = SizeOf(b) - size;
+    if (rest < MIN_BLOCK) {
+        b->size |= IN_USE;
+        return;
+    }
+    Resize(b, size, IN_USE);
+    Block* tail = After(b);
+    Resize(tail, rest, 0);
+    Insert(tail);
+}
+
+static void ReleaseTop(Block* top) {
+    uint32_t release = (SizeOf(top) - TRIM_KEEP) & ~(PAGE_SIZE - 1);
+    if (!sbrk(-(int)release)) return;
+
+    heap_end -= release;
+    Resize(top, SizeOf(top) - release, 0);
+    Epilogue()->size = IN_USE;
+}
+
+// Merge a block that just became free with free neighbours and list it.
+// 'trim' lets a large top block go back to the kernel.
+static void Coalesce(Block* b, bool trim) {
+    b->size &= ~IN_USE;
+
+    Block* next = After(b);
+    if (IsFree(next)) {
+        Unlink(next);
+        Resize(b, SizeOf(b) + SizeOf(next), 0);
+    }
+    if (b->prev_size && IsFree(Before(b))) {
+        Block* prev = Before(b);
+        Unlink(prev);
+        Resize(prev, SizeOf(prev) + SizeOf(b), 0);
+        b = prev;
+    }
+
+    if (trim && After(b) == Epilogue() && SizeOf(b) >= TRIM_THRESHOLD) ReleaseTop(b);
+    Insert(b);
+}
+
+static inline uint32_t PageRound(uint32_t n) { return (n + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1); }
+
+// Extend the heap so a block of 'size' bytes fits
+static bool Grow(uint32_t size) {
+    if (!heap_start) {
+        heap_start = heap_end = (uint8_t*)sbrk(0);
+        if (!heap_start) return false;
+    }
+    if (heap_end == heap_start) {
+        size += HEADER_SIZE; // Room for the epilogue
+    } else {
+        // A free block at the top merges with the new space
+        Block* top = Before(Epilogue());
+        if (Epilogue()->prev_size && IsFree(top)) size -= SizeOf(top);
+    }
+
+    uint32_t bytes = PageRound(size);
+    if (bytes < grow_size) bytes = grow_size;
+
+    uint8_t* base = (uint8_t*)sbrk(bytes);
+    if (!base && bytes > PageRound(size)) {
+        bytes = PageRound(size); // Near the heap limit: just what is needed
+        base = (uint8_t*)sbrk(bytes);
+    }
+    if (!base || base != heap_end) return false;
+    if (grow_size < GROW_MAX) grow_size *= 2;
+
+    Block* b;
+    if (heap_end == heap_start) {
+        // First segment: the epilogue takes its last 8 bytes
+        b = (Block*)heap_start;
+        b->prev_size = 0;
+        heap_end = base + bytes;
+        bytes -= HEADER_SIZE;
+    } else {
+        b = Epilogue(); // The old epilogue becomes the new block's header
+        heap_end = base + bytes;
+    }
+    b->size = bytes | IN_USE;
+    Epilogue()->prev_size = bytes;
+    Epilogue()->size = IN_USE;
+    Coalesce(b, false);
+    return true;
+}
+
+void* malloc(size_t size) {
+    if (size > MAX_REQUEST) return 0;
+    uint32_t need = (size + HEADER_SIZE + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+    if (need < MIN_BLOCK) need = MIN_BLOCK;
+
+    Block* b = TakeFit(need);
+    if (!b) {
+        if (!Grow(need)) return 0;
+        b = TakeFit(need);
+        if (!b) return 0;
+    }
+    Split(b, need);
+
+    stats.allocs++;
+    stats.used_bytes += SizeOf(b);
+    return (uint8_t*)b + HEADER_SIZE;
+}
+
+void free(void* ptr) {
+    if (!ptr) return;
+    Block* b = (Block*)((uint8_t*)ptr - HEADER_SIZE);
+
+    stats.frees++;
+    stats.used_bytes -= SizeOf(b);
+    Coalesce(b, true);
+}
+
+void* calloc(size_t count, size_t size) {
+    if (size && count > MAX_REQUEST / size) return 0;
+    uint32_t total = count * size;
+    uint32_t* p = (uint32_t*)malloc(total);
+    if (p) {
+        // Payloads are 8-byte multiples, so whole words are safe
+        for (uint32_t i = 0; i < (total + 3) / 4; i++) p[i] = 0;
+    }
+    return p;
+}
+
+void* realloc(void* ptr, size_t size) {
+    if (!ptr) return malloc(size);
+    if (size == 0) { free(ptr); return 0; }
+    if (size > MAX_REQUEST) return 0;
+
+    Block* b = (Block*)((uint8_t*)ptr - HEADER_SIZE);
+    uint32_t old = SizeOf(b);
+    uint32_t need = (size + HEADER_SIZE + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+    if (need < MIN_BLOCK) need = MIN_BLOCK;
+
+    // Grow in place into a free neighbour above
+    Block* next = After(b);
+    if (need > old && IsFree(next) && old + SizeOf(next) >= need) {
+        Unlink(next);
+        Resize(b, old + SizeOf(next), IN_USE);
+    }
+
+    if (SizeOf(b) >= need) {
+        // Shrink (or trim what the merge over-took); the tail is freed
+        if (SizeOf(b) - need >= MIN_BLOCK) {
+            uint32_t rest = SizeOf(b) - need;
+            Resize(b, need, IN_USE);
+            Block* tail = After(b);
+            Resize(tail, rest, IN_USE);
+            Coalesce(tail, true);
+        }
+        stats.used_bytes += SizeOf(b) - old;
+        return ptr;
+    }
+
+    uint32_t* fresh = (uint32_t*)malloc(size);
+    if (!fresh) return 0;
+    uint32_t* src = (uint32_t*)ptr;
+    for (uint32_t i = 0; i < (old - HEADER_SIZE) / 4; i++) fresh[i] = src[i];
+    free(ptr);
+    return fresh;
+}
+
+void malloc_stats(MallocStats* out) {
+    *out = stats;
+    out->heap_bytes = heap_end - heap_start;
+}
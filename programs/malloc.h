@@ -0,0 +1,30 @@
+#ifndef MALLOC_H
+#define MALLOC_H
+#include <stdint.h>
+#include <stddef.h>
+
+// User Space Allocator
+// Boundary-tag heap on top of the program break (syscall 45):
+// - Exact-fit free lists for blocks up to 512 bytes, power-of-two classes above
+// - Blocks are split on allocation and coalesced with both neighbours on free
+// - The break grows geometrically in page multiples (16 KiB doubling to 1 MiB),
+//   and a large free block at the top is handed back to the kernel
+// The allocator owns the break: programs must not call syscall 45 themselves.
+
+struct MallocStats {
+    uint32_t heap_bytes;   // Between heap start and the current break
+    uint32_t used_bytes;   // Allocated blocks, headers included
+    uint32_t free_bytes;   // Sitting in the free lists
+    uint32_t free_blocks;
+    uint32_t allocs;
+    uint32_t frees;
+    uint32_t sbrk_calls;
+};
+
+void* malloc(size_t size);
+void free(void* ptr);
+void* calloc(size_t count, size_t size);
+void* realloc(void* ptr, size_t size);
+
+void malloc_stats(MallocStats* out);
+#endif
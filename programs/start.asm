@@ -5,5 +5,8 @@ extern main
 _start:
     call main
 
-    ; Force Infinite Loop (Exit syscall later)
+    ; Exit syscall (1) when main returns
+    mov ebx, eax
+    mov eax, 1
+    int 0x80
     jmp $
@@ -0,0 +1,45 @@
+#include "stdio.h"
+
+extern "C" int syscall(int num, int a1, int a2, int a3);
+
+struct iovec { const void* base; uint32_t len; };
+
+static char out_buf[STDOUT_BUFFER];
+static int out_len = 0;
+
+void flush() {
+    if (out_len) syscall(4, 1, (int)out_buf, out_len);
+    out_len = 0;
+}
+
+void write_out(const char* buf, int len) {
+    if (len <= 0) return;
+    if (out_len + len > STDOUT_BUFFER) {
+        // Buffered bytes first, then these, in one call
+        iovec iov[2] = { { out_buf, (uint32_t)out_len }, { buf, (uint32_t)len } };
+        syscall(146, 1, (int)iov, 2);
+        out_len = 0;
+        return;
+    }
+
+    bool newline = false;
+    for (int i = 0; i < len; i++) {
+        out_buf[out_len++] = buf[i];
+        if (buf[i] == '\n') newline = true;
+    }
+    if (newline) flush();
+}
+
+void print(const char* str) {
+    int len = 0;
+    while (str[len]) len++;
+    write_out(str, len);
+}
+
+void putc(char c) { write_out(&c, 1); }
+
+void printu(uint32_t v) {
+    char buf[11]; int i = 10; buf[i] = 0;
+    do { buf[--i] = '0' + v % 10; v /= 10; } while (v);
+    write_out(buf + i, 10 - i);
+}
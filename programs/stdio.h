@@ -0,0 +1,19 @@
+#ifndef STDIO_H
+#define STDIO_H
+#include <stdint.h>
+
+// Buffered Console Output
+// Output collects in a user-space buffer and reaches the kernel in one
+// write: on a newline, when the buffer is full, or on flush(). A string
+// that doesn't fit goes out together with what is buffered, in a single
+// writev() (syscall 146), without being copied first.
+// Call flush() before anything that waits on the user (read() does not).
+
+#define STDOUT_BUFFER 256
+
+void print(const char* str);
+void putc(char c);
+void printu(uint32_t v);
+void write_out(const char* buf, int len);
+void flush();
+#endif
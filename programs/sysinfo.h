@@ -0,0 +1,30 @@
+#ifndef SYSINFO_H
+#define SYSINFO_H
+#include <stdint.h>
+
+// The kernel's shared info page, mapped read-only into every process.
+// Same layout as SysInfoPage in src/core/sysinfo.h (see there for the
+// read protocol).
+
+#define SYSINFO_ADDR    0x80000000 // USER_SYSINFO_PAGE
+#define SYSINFO_VERSION 1
+
+struct SysInfoPage {
+    volatile uint32_t seq;
+    uint32_t version;
+    uint64_t ticks;
+    uint64_t mono_ns;
+    uint64_t tsc;
+    uint64_t ns_per_cycle;
+    uint32_t tick_hz;
+    uint32_t boot_time;
+    uint32_t cpu_count;
+    uint32_t cpu_signature;
+    uint32_t cpu_features_edx;
+    uint32_t cpu_features_ecx;
+    uint32_t tsc_khz;
+    char cpu_vendor[16];
+};
+
+#define sysinfo ((const SysInfoPage*)SYSINFO_ADDR)
+#endif
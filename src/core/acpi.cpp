@@ -0,0 +1,176 @@
+#include "acpi.h"
+#include "paging.h"
+#include "../utils/StringHelpers.h"
+
+#define EBDA_SEGMENT_PTR 0x40E             // BDA word: EBDA segment
+#define BIOS_ROM_START   0xE0000
+#define BIOS_ROM_END     0x100000
+
+#define MADT_LAPIC       0
+#define MADT_IOAPIC      1
+#define MADT_OVERRIDE    2
+#define MADT_LAPIC_ADDR  5
+
+#define RSDT_MAX_ENTRIES 64 // Tables looked at
+
+#define LAPIC_ENABLED    0x1
+#define LAPIC_ONLINE_CAP 0x2 // Disabled, but may be brought online
+
+// MPS INTI flags: 0 in a field means "as the bus says" (ISA: high, edge)
+#define INTI_POLARITY_MASK 0x3
+#define INTI_POLARITY_LOW  0x3
+#define INTI_TRIGGER_MASK  0xC
+#define INTI_TRIGGER_LEVEL 0xC
+
+struct Rsdp {
+    char signature[8]; // "RSD PTR "
+    uint8_t checksum;
+    char oem[6];
+    uint8_t revision;
+    uint32_t rsdt;
+} __attribute__((packed));
+
+struct SdtHeader {
+    char signature[4];
+    uint32_t length;   // Header included
+    uint8_t revision;
+    uint8_t checksum;
+    char oem[6];
+    char oem_table[8];
+    uint32_t oem_revision;
+    uint32_t creator;
+    uint32_t creator_revision;
+} __attribute__((packed));
+
+bool ACPI::madt = false;
+uint32_t ACPI::cpu_count = 0;
+uint8_t ACPI::cpu_apic_ids[ACPI_MAX_CPUS];
+uint32_t ACPI::ioapic_count = 0;
+AcpiIoApic ACPI::ioapics[ACPI_MAX_IOAPICS];
+uint32_t ACPI::isa_gsi[ACPI_ISA_IRQS];
+uint8_t ACPI::isa_flags[ACPI_ISA_IRQS];
+
+static bool Checksum(const uint8_t* p, uint32_t length) {
+    uint8_t sum = 0;
+    for (uint32_t i = 0; i < length; i++) sum += p[i];
+    return sum == 0;
+}
+
+static const Rsdp* ScanRsdp(uint32_t start, uint32_t end) {
+    for (uint32_t p = start; p + sizeof(Rsdp) <= end; p += 16) {
+        const Rsdp* r = (const Rsdp*)p;
+        if (Utils::strncmp(r->signature, "RSD PTR ", 8) == 0 && Checksum((const uint8_t*)r, sizeof(Rsdp))) return r;
+    }
+    return 0;
+}
+
+// Firmware puts the tables at the top of RAM, which may be past the
+// identity map: those are mapped just while they are read
+static const uint8_t* MapTable(uint32_t phys, uint32_t length) {
+    if (phys + length <= IDENTITY_MAP_SIZE && phys + length > phys) return (const uint8_t*)phys;
+    if (!PageTableManager::MapRange(phys, phys, length, 0, "acpi")) return 0;
+    return (const uint8_t*)phys;
+}
+
+static void UnmapTable(uint32_t phys, uint32_t length) {
+    if (phys + length > IDENTITY_MAP_SIZE || phys + length < phys) PageTableManager::UnmapRange(phys, length);
+}
+
+// Map a whole table, verified; 0 if it isn't one
+static const uint8_t* MapSdt(uint32_t phys, uint32_t* length) {
+    const SdtHeader* h = (const SdtHeader*)MapTable(phys, sizeof(SdtHeader));
+    if (!h) return 0;
+    *length = h->length;
+    UnmapTable(phys, sizeof(SdtHeader));
+    if (*length < sizeof(SdtHeader)) return 0;
+
+    const uint8_t* table = MapTable(phys, *length);
+    if (table && !Checksum(table, *length)) {
+        UnmapTable(phys, *length);
+        return 0;
+    }
+    return table;
+}
+
+bool ACPI::Init() {
+    for (uint32_t i = 0; i < ACPI_ISA_IRQS; i++) {
+        isa_gsi[i] = i; // Identity unless overridden
+        isa_flags[i] = 0;
+    }
+
+    uint32_t ebda = (uint32_t)(*(uint16_t*)EBDA_SEGMENT_PTR) << 4;
+    const Rsdp* rsdp = ebda ? ScanRsdp(ebda, ebda + 1024) : 0;
+    if (!rsdp) rsdp = ScanRsdp(BIOS_ROM_START, BIOS_ROM_END);
+    if (!rsdp) return false;
+
+    uint32_t rsdt_length;
+    const uint8_t* rsdt = MapSdt(rsdp->rsdt, &rsdt_length);
+    if (!rsdt) return false;
+
+    // The RSDT is a header followed by 32-bit table addresses. Firmware
+    // packs tables together, so the RSDT may share a page with the tables
+    // it lists: copy the list out and unmap it before mapping any of them,
+    // so only one table is ever mapped at a time.
+    uint32_t entries[RSDT_MAX_ENTRIES];
+    uint32_t count = (rsdt_length - sizeof(SdtHeader)) / 4;
+    if (count > RSDT_MAX_ENTRIES) count = RSDT_MAX_ENTRIES;
+    const uint32_t* list = (const uint32_t*)(rsdt + sizeof(SdtHeader));
+    for (uint32_t i = 0; i < count; i++) entries[i] = list[i];
+    UnmapTable(rsdp->rsdt, rsdt_length);
+
+    for (uint32_t i = 0; i < count && !madt; i++) {
+        uint32_t length;
+        const uint8_t* table = MapSdt(entries[i], &length);
+        if (!table) continue;
+        if (Utils::strncmp((const char*)table, "APIC", 4) == 0) ParseMadt(table, length);
+        UnmapTable(entries[i], length);
+    }
+
+    return madt;
+}
+
+void ACPI::ParseMadt(const uint8_t* table, uint32_t length) {
+    // Header, local APIC address, flags, then variable-length entries
+    const uint8_t* p = table + sizeof(SdtHeader) + 8;
+    const uint8_t* end = table + length;
+
+    while (p + 2 <= end && p[1] >= 2 && p + p[1] <= end) {
+        switch (p[0]) {
+        case MADT_LAPIC: {
+            uint32_t flags = *(const uint32_t*)(p + 4);
+            if ((flags & LAPIC_ENABLED) && cpu_count < ACPI_MAX_CPUS) cpu_apic_ids[cpu_count++] = p[3];
+            break;
+        }
+        case MADT_IOAPIC:
+            if (ioapic_count < ACPI_MAX_IOAPICS) {
+                AcpiIoApic* io = &ioapics[ioapic_count++];
+                io->id = p[2];
+                io->address = *(const uint32_t*)(p + 4);
+                io->gsi_base = *(const uint32_t*)(p + 8);
+            }
+            break;
+        case MADT_OVERRIDE: {
+            uint8_t irq = p[3];
+            uint16_t inti = *(const uint16_t*)(p + 8);
+            if (p[2] != 0 || irq >= ACPI_ISA_IRQS) break; // Bus 0 = ISA
+            isa_gsi[irq] = *(const uint32_t*)(p + 4);
+            isa_flags[irq] = 0;
+            if ((inti & INTI_POLARITY_MASK) == INTI_POLARITY_LOW) isa_flags[irq] |= ACPI_IRQ_ACTIVE_LOW;
+            if ((inti & INTI_TRIGGER_MASK) == INTI_TRIGGER_LEVEL) isa_flags[irq] |= ACPI_IRQ_LEVEL;
+            break;
+        }
+        }
+        p += p[1];
+    }
+
+    madt = cpu_count > 0;
+}
+
+uint32_t ACPI::IsaGsi(uint8_t irq, uint32_t* flags) {
+    if (irq >= ACPI_ISA_IRQS) {
+        *flags = 0;
+        return irq;
+    }
+    *flags = isa_flags[irq];
+    return isa_gsi[irq];
+}
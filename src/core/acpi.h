@@ -0,0 +1,50 @@
+#ifndef ACPI_H
+#define ACPI_H
+#include <stdint.h>
+#include "cpu.h"
+
+// ACPI tables: just enough to find the interrupt hardware.
+// The MADT ("APIC" table) lists every CPU's local APIC, the I/O APICs and
+// how the ISA IRQs are wired to their inputs. It is parsed once at boot
+// into the fields below; the tables themselves are not kept mapped.
+
+#define ACPI_MAX_CPUS    32 // Local APICs remembered (only MAX_CPUS are started)
+#define ACPI_MAX_IOAPICS 4
+#define ACPI_ISA_IRQS    16
+
+// How an interrupt input is signalled (from MADT interrupt source overrides)
+#define ACPI_IRQ_ACTIVE_LOW 0x1
+#define ACPI_IRQ_LEVEL      0x2
+
+struct AcpiIoApic {
+    uint8_t id;
+    uint32_t address;  // Physical MMIO base
+    uint32_t gsi_base; // First global system interrupt it serves
+};
+
+class ACPI {
+public:
+    static bool Init(); // false: no RSDP or no MADT
+    static bool HasMadt() { return madt; }
+
+    static uint32_t CpuCount() { return cpu_count; } // Enabled local APICs
+    static uint8_t CpuApicId(uint32_t i) { return cpu_apic_ids[i]; }
+
+    static uint32_t IoApicCount() { return ioapic_count; }
+    static const AcpiIoApic* IoApic(uint32_t i) { return &ioapics[i]; }
+
+    // Global system interrupt ISA 'irq' arrives on, and its ACPI_IRQ_* flags
+    static uint32_t IsaGsi(uint8_t irq, uint32_t* flags);
+
+private:
+    static void ParseMadt(const uint8_t* table, uint32_t length);
+
+    static bool madt;
+    static uint32_t cpu_count;
+    static uint8_t cpu_apic_ids[ACPI_MAX_CPUS];
+    static uint32_t ioapic_count;
+    static AcpiIoApic ioapics[ACPI_MAX_IOAPICS];
+    static uint32_t isa_gsi[ACPI_ISA_IRQS];
+    static uint8_t isa_flags[ACPI_ISA_IRQS];
+};
+#endif
@@ -0,0 +1,86 @@
+; Application Processor Startup Trampoline
+; SMP::Init copies this to SMP_TRAMPOLINE (0x8000) and broadcasts the
+; startup IPI. Each AP wakes here in real mode, switches to protected mode
+; with paging on (the kernel directory), claims a CPU index and a stack,
+; and calls the C++ entry with the index. Code and data address themselves
+; through the copy, never through where the linker put them.
+
+AP_BASE equ 0x8000
+%define REL(x) (AP_BASE + (x) - ap_trampoline_start)
+
+section .text
+global ap_trampoline_start
+global ap_trampoline_end
+global ap_params
+
+[BITS 16]
+ap_trampoline_start:
+    cli
+    cld
+    xor ax, ax
+    mov ds, ax
+    lgdt [REL(ap_gdtr)]
+    mov eax, cr0
+    or eax, 1                   ; PE
+    mov cr0, eax
+    jmp dword 0x08:REL(ap_protected)
+
+[BITS 32]
+ap_protected:
+    mov ax, 0x10
+    mov ds, ax
+    mov es, ax
+    mov fs, ax
+    mov gs, ax
+    mov ss, ax
+
+    ; Same paging setup as the boot CPU: PSE/PGE first, then the directory
+    mov eax, [REL(ap_cr4)]
+    mov cr4, eax
+    mov eax, [REL(ap_cr3)]
+    mov cr3, eax
+    mov eax, cr0
+    and eax, 0x9FFFFFFF         ; Clear CD | NW: INIT leaves caching off
+    or eax, 0x80010000          ; PG | WP
+    mov cr0, eax
+
+    ; CPU index = order of arrival (the boot CPU is 0)
+    mov eax, 1
+    lock xadd [REL(ap_next)], eax
+    cmp eax, [REL(ap_max)]
+    jae .park
+
+    ; Stack n is the n-th block of ap_stack_size bytes above ap_stacks
+    mov ebx, eax
+    imul ebx, [REL(ap_stack_size)]
+    add ebx, [REL(ap_stacks)]
+    mov esp, ebx
+
+    push eax                    ; Arg: CPU index
+    call [REL(ap_entry)]        ; Does not return
+
+.park:                          ; More CPUs than MAX_CPUS: leave them halted
+    cli
+    hlt
+    jmp .park
+
+align 8
+ap_gdt:
+    dq 0
+    dq 0x00CF9A000000FFFF       ; 0x08: flat code, like the kernel GDT
+    dq 0x00CF92000000FFFF       ; 0x10: flat data
+ap_gdtr:
+    dw 23
+    dd REL(ap_gdt)
+
+; Filled in by SMP::Init (layout of struct ApParams)
+align 4
+ap_params:
+ap_cr3:        dd 0
+ap_cr4:        dd 0
+ap_entry:      dd 0
+ap_stacks:     dd 0
+ap_stack_size: dd 0
+ap_next:       dd 0
+ap_max:        dd 0
+ap_trampoline_end:
@@ -0,0 +1,89 @@
+#include "clock.h"
+#include "cpu.h"
+#include "interrupts.h"
+#include "../drivers/pit.h"
+
+#define PIT_CHANNEL2     0x42
+#define PIT_COMMAND      0x43
+#define PIT_CH2_ONESHOT  0xB0 // Channel 2, lobyte/hibyte, mode 0 (interrupt on terminal count)
+#define PIT_GATE_PORT    0x61
+#define PIT_GATE2        0x01 // Channel 2 gate
+#define PIT_SPEAKER      0x02 // Speaker data enable (kept off)
+#define PIT_OUT2         0x20 // Channel 2 output, set at terminal count
+
+#define CALIBRATE_MS     10
+#define CALIBRATE_RUNS   3    // Keep the shortest: an SMI can only make a run longer
+#define CALIBRATE_SPIN   10000000 // Give up if OUT2 never rises (no channel 2)
+
+#define FEATURE_EXT_INVARIANT_TSC (1u << 8) // CPUID 0x80000007 EDX
+
+bool Clock::tsc = false;
+bool Clock::invariant = false;
+uint32_t Clock::tsc_khz = 0;
+uint64_t Clock::tsc_base = 0;
+uint64_t Clock::ns_per_cycle = 0;
+
+// TSC cycles across one CALIBRATE_MS one-shot of PIT channel 2 (0 = no PIT)
+static uint32_t MeasureCycles(uint32_t latch) {
+    uint8_t gate = InterruptManager::ReadPort(PIT_GATE_PORT);
+    InterruptManager::WritePort(PIT_GATE_PORT, (gate & ~PIT_SPEAKER) | PIT_GATE2);
+
+    InterruptManager::WritePort(PIT_COMMAND, PIT_CH2_ONESHOT);
+    InterruptManager::WritePort(PIT_CHANNEL2, latch & 0xFF);
+    InterruptManager::WritePort(PIT_CHANNEL2, (latch >> 8) & 0xFF);
+
+    uint64_t start = CPU::ReadTSC();
+    uint32_t spin = 0;
+    while (!(InterruptManager::ReadPort(PIT_GATE_PORT) & PIT_OUT2)) {
+        if (++spin == CALIBRATE_SPIN) {
+            InterruptManager::WritePort(PIT_GATE_PORT, gate); // Gate and speaker as found
+            return 0;
+        }
+    }
+    uint64_t end = CPU::ReadTSC();
+
+    InterruptManager::WritePort(PIT_GATE_PORT, gate);
+    return (uint32_t)(end - start);
+}
+
+void Clock::Init() {
+    if (!CPU::Has(CPU::FEATURE_TSC)) return;
+
+    uint32_t latch = PIT_INPUT_HZ / (1000 / CALIBRATE_MS);
+    uint32_t cycles = 0;
+    for (int i = 0; i < CALIBRATE_RUNS; i++) {
+        uint32_t c = MeasureCycles(latch);
+        if (c && (!cycles || c < cycles)) cycles = c;
+    }
+    if (!cycles) return;
+
+    // The one-shot lasted exactly latch PIT cycles
+    uint64_t elapsed_ns = udiv64((uint64_t)latch * 1000000000, PIT_INPUT_HZ, 0);
+    ns_per_cycle = udiv64(elapsed_ns << 32, cycles, 0);
+    tsc_khz = (uint32_t)udiv64((uint64_t)cycles * PIT_INPUT_HZ, latch * 1000, 0);
+
+    uint32_t a, b, c, d;
+    CPU::Cpuid(0x80000000, 0, &a, &b, &c, &d);
+    if (a >= 0x80000007) {
+        CPU::Cpuid(0x80000007, 0, &a, &b, &c, &d);
+        invariant = (d & FEATURE_EXT_INVARIANT_TSC) != 0;
+    }
+
+    tsc_base = CPU::ReadTSC();
+    tsc = true;
+}
+
+uint64_t Clock::Nanoseconds() {
+    if (!tsc) return PIT::Nanoseconds();
+    return FromTSC(CPU::ReadTSC());
+}
+
+uint64_t Clock::FromTSC(uint64_t cycles) {
+    cycles -= tsc_base;
+    return cycles * (uint32_t)(ns_per_cycle >> 32) + mul64_frac32(cycles, (uint32_t)ns_per_cycle);
+}
+
+void Clock::DelayUs(uint32_t us) {
+    uint64_t deadline = Deadline(us);
+    while (!Expired(deadline)) asm volatile("pause");
+}
@@ -0,0 +1,37 @@
+#ifndef CLOCK_H
+#define CLOCK_H
+#include <stdint.h>
+#include "../utils/math.h"
+
+// High-resolution monotonic clock.
+// Counts TSC cycles, calibrated once against PIT channel 2 at boot, so it
+// works before interrupts are enabled and resolves to a few nanoseconds.
+// Without a TSC it falls back to PIT::Nanoseconds(), which needs IRQ0.
+
+class Clock {
+public:
+    static void Init();                // After CPU::Init(), before polling drivers
+    static uint64_t Nanoseconds();     // Since Init
+    static uint64_t Microseconds() { return udiv64(Nanoseconds(), 1000, 0); }
+
+    static bool UsesTSC() { return tsc; }
+    static bool Invariant() { return invariant; } // TSC rate survives P/C-states
+    static uint32_t TscKHz() { return tsc_khz; }
+    // The TSC conversion, for readers outside the kernel (SysInfo): the
+    // clock at TSC value 'cycles', and the ns per cycle in 32.32 fixed point
+    static uint64_t FromTSC(uint64_t cycles);
+    static uint64_t NsPerCycle() { return ns_per_cycle; }
+
+    // Polling with a timeout: deadline = Deadline(us); ... until Expired(deadline)
+    static uint64_t Deadline(uint32_t us) { return Nanoseconds() + (uint64_t)us * 1000; }
+    static bool Expired(uint64_t deadline) { return Nanoseconds() >= deadline; }
+    static void DelayUs(uint32_t us);
+
+private:
+    static bool tsc;
+    static bool invariant;
+    static uint32_t tsc_khz;
+    static uint64_t tsc_base;
+    static uint64_t ns_per_cycle; // 32.32 fixed point
+};
+#endif
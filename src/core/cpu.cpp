@@ -0,0 +1,33 @@
+#include "cpu.h"
+
+uint32_t CPU::max_leaf = 0;
+uint32_t CPU::signature = 0;
+uint32_t CPU::features_edx = 0;
+uint32_t CPU::features_ecx = 0;
+uint32_t CPU::features7_ebx = 0;
+char CPU::vendor[13] = {0};
+
+void CPU::Init() {
+    uint32_t a, b, c, d;
+
+    // Leaf 0: Highest leaf + Vendor ("GenuineIntel" is EBX, EDX, ECX)
+    Cpuid(0, 0, &a, &b, &c, &d);
+    max_leaf = a;
+    uint32_t regs[3] = { b, d, c };
+    for (int i = 0; i < 12; i++) vendor[i] = (char)(regs[i / 4] >> ((i % 4) * 8));
+    vendor[12] = 0;
+
+    // Leaf 1: Signature + Feature Flags
+    if (max_leaf >= 1) {
+        Cpuid(1, 0, &a, &b, &c, &d);
+        signature = a;
+        features_edx = d;
+        features_ecx = c;
+    }
+
+    // Leaf 7: Structured Extended Features
+    if (max_leaf >= 7) {
+        Cpuid(7, 0, &a, &b, &c, &d);
+        features7_ebx = b;
+    }
+}
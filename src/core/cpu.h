@@ -0,0 +1,98 @@
+#ifndef CPU_H
+#define CPU_H
+#include <stdint.h>
+
+#define MAX_CPUS 8 // Processors brought up, the boot CPU included
+
+// CPUID feature probe, filled once at boot by CPU::Init().
+class CPU {
+public:
+    // Leaf 1 EDX
+    static const uint32_t FEATURE_FPU   = 1u << 0;
+    static const uint32_t FEATURE_PSE   = 1u << 3;
+    static const uint32_t FEATURE_TSC   = 1u << 4;
+    static const uint32_t FEATURE_MSR   = 1u << 5;
+    static const uint32_t FEATURE_APIC  = 1u << 9;
+    static const uint32_t FEATURE_SEP   = 1u << 11;
+    static const uint32_t FEATURE_PGE   = 1u << 13;
+    static const uint32_t FEATURE_FXSR  = 1u << 24;
+    static const uint32_t FEATURE_SSE   = 1u << 25;
+    static const uint32_t FEATURE_SSE2  = 1u << 26;
+
+    // Leaf 1 ECX
+    static const uint32_t FEATURE_ECX_MONITOR = 1u << 3;  // MONITOR/MWAIT
+    static const uint32_t FEATURE_ECX_XSAVE   = 1u << 26;
+    static const uint32_t FEATURE_ECX_OSXSAVE = 1u << 27;
+    static const uint32_t FEATURE_ECX_AVX     = 1u << 28;
+
+    // Leaf 7 (subleaf 0) EBX
+    static const uint32_t FEATURE7_AVX2 = 1u << 5;
+    static const uint32_t FEATURE7_ERMS = 1u << 9; // Fast "rep movsb/stosb"
+
+    static void Init();
+    static bool Has(uint32_t edx_feature) { return (features_edx & edx_feature) != 0; }
+    static bool HasEcx(uint32_t ecx_feature) { return (features_ecx & ecx_feature) != 0; }
+    static bool HasExtended(uint32_t leaf7_ebx_feature) { return (features7_ebx & leaf7_ebx_feature) != 0; }
+
+    static const char* Vendor() { return vendor; }
+    static uint32_t Signature() { return signature; } // Leaf 1 EAX (family/model/stepping)
+    static uint32_t FeaturesEdx() { return features_edx; }
+    static uint32_t FeaturesEcx() { return features_ecx; }
+
+    static void Cpuid(uint32_t leaf, uint32_t subleaf, uint32_t* a, uint32_t* b, uint32_t* c, uint32_t* d) {
+        asm volatile("cpuid" : "=a"(*a), "=b"(*b), "=c"(*c), "=d"(*d) : "a"(leaf), "c"(subleaf));
+    }
+
+    static uint64_t ReadTSC() {
+        uint64_t v;
+        asm volatile("rdtsc" : "=A"(v));
+        return v;
+    }
+
+    // IRQ-off critical sections that nest: restore what was there before
+    static uint32_t SaveAndDisableInterrupts() {
+        uint32_t flags;
+        asm volatile("pushf; pop %0; cli" : "=r"(flags) : : "memory");
+        return flags;
+    }
+    static void RestoreInterrupts(uint32_t flags) {
+        asm volatile("push %0; popf" : : "r"(flags) : "memory", "cc");
+    }
+
+    static uint64_t ReadMSR(uint32_t msr) {
+        uint64_t v;
+        asm volatile("rdmsr" : "=A"(v) : "c"(msr));
+        return v;
+    }
+    static void WriteMSR(uint32_t msr, uint64_t v) {
+        asm volatile("wrmsr" : : "c"(msr), "A"(v));
+    }
+
+    static uint32_t ReadCR4() {
+        uint32_t v;
+        asm volatile("mov %%cr4, %0" : "=r"(v));
+        return v;
+    }
+    static void WriteCR4(uint32_t v) {
+        asm volatile("mov %0, %%cr4" : : "r"(v) : "memory");
+    }
+
+private:
+    static uint32_t max_leaf;
+    static uint32_t signature;
+    static uint32_t features_edx;
+    static uint32_t features_ecx;
+    static uint32_t features7_ebx;
+    static char vendor[13];
+};
+
+// Interrupts off for the rest of the enclosing scope (nests). Keeps shared
+// kernel structures consistent now that threads can be preempted.
+class InterruptGuard {
+public:
+    InterruptGuard() : flags(CPU::SaveAndDisableInterrupts()) {}
+    ~InterruptGuard() { CPU::RestoreInterrupts(flags); }
+private:
+    uint32_t flags;
+};
+#endif
@@ -0,0 +1,152 @@
+#include "fpu.h"
+#include "cpu.h"
+#include "smp.h"
+
+#define CR0_MP 0x02 // WAIT/FWAIT honour TS
+#define CR0_EM 0x04 // Emulate: must be clear for real FPU/SSE
+#define CR0_TS 0x08 // Task switched: next FPU op raises #NM
+#define CR0_NE 0x20 // Native x87 error reporting
+
+#define CR4_OSFXSR     0x200 // FXSAVE/FXRSTOR + SSE enabled
+#define CR4_OSXMMEXCPT 0x400 // Unmasked SSE exceptions raise #XM
+#define CR4_OSXSAVE    0x40000 // XSAVE/XRSTOR + XCR0
+
+#define XCR0_X87_SSE_AVX 0x7 // State components managed with XSAVE
+
+#define MXCSR_DEFAULT  0x1F80 // All exceptions masked, round to nearest
+
+bool FPU::fxsr = false;
+bool FPU::sse = false;
+bool FPU::sse2 = false;
+bool FPU::avx = false;
+FpuState* FPU::owner[MAX_CPUS];
+FpuState* FPU::current[MAX_CPUS];
+
+static inline uint32_t ReadCR0() {
+    uint32_t v;
+    asm volatile("mov %%cr0, %0" : "=r"(v));
+    return v;
+}
+
+static inline void WriteCR0(uint32_t v) {
+    asm volatile("mov %0, %%cr0" : : "r"(v) : "memory");
+}
+
+static inline void SetTS() { WriteCR0(ReadCR0() | CR0_TS); }
+static inline void ClearTS() { asm volatile("clts"); }
+
+// With AVX on, XSAVE is required: FXSAVE would drop the upper YMM halves
+static void Save(FpuState* s, bool fxsr, bool xsave) {
+    if (xsave) asm volatile("xsave (%0)" : : "r"(s->image), "a"(XCR0_X87_SSE_AVX), "d"(0) : "memory");
+    else if (fxsr) asm volatile("fxsave (%0)" : : "r"(s->image) : "memory");
+    else asm volatile("fnsave (%0)" : : "r"(s->image) : "memory");
+}
+
+static void Restore(FpuState* s, bool fxsr, bool xsave) {
+    if (xsave) asm volatile("xrstor (%0)" : : "r"(s->image), "a"(XCR0_X87_SSE_AVX), "d"(0) : "memory");
+    else if (fxsr) asm volatile("fxrstor (%0)" : : "r"(s->image) : "memory");
+    else asm volatile("frstor (%0)" : : "r"(s->image) : "memory");
+}
+
+static void Reset(bool sse) {
+    asm volatile("fninit");
+    if (sse) {
+        uint32_t mxcsr = MXCSR_DEFAULT;
+        asm volatile("ldmxcsr %0" : : "m"(mxcsr));
+    }
+}
+
+void FPU::Init() {
+    if (!CPU::Has(CPU::FEATURE_FPU)) return;
+
+    WriteCR0((ReadCR0() & ~(CR0_EM | CR0_TS)) | CR0_MP | CR0_NE);
+
+    fxsr = CPU::Has(CPU::FEATURE_FXSR);
+    sse = fxsr && CPU::Has(CPU::FEATURE_SSE);
+    if (sse) CPU::WriteCR4(CPU::ReadCR4() | CR4_OSFXSR | CR4_OSXMMEXCPT);
+    sse2 = sse && CPU::Has(CPU::FEATURE_SSE2);
+
+    if (sse && CPU::HasEcx(CPU::FEATURE_ECX_XSAVE) && CPU::HasEcx(CPU::FEATURE_ECX_AVX)) {
+        CPU::WriteCR4(CPU::ReadCR4() | CR4_OSXSAVE);
+        asm volatile("xsetbv" : : "c"(0), "a"(XCR0_X87_SSE_AVX), "d"(0));
+        avx = true;
+    }
+
+    Reset(sse);
+}
+
+// Callers run with IRQs off (switches, traps) or disable them
+void FPU::SwitchTo(FpuState* state) {
+    uint32_t cpu = SMP::CpuIndex();
+    FpuState* prev = current[cpu];
+
+    // TS clear with the outgoing task's registers loaded: it may have
+    // changed them, and could resume elsewhere next
+    if (prev && owner[cpu] == prev && !(ReadCR0() & CR0_TS)) {
+        Save(prev, fxsr, avx);
+        if (!fxsr) owner[cpu] = 0; // FNSAVE reinitialises the unit
+    }
+
+    current[cpu] = state;
+    // Registers already hold this state (or nobody needs them): no trap
+    if (!state || (state == owner[cpu] && state->cpu == cpu)) ClearTS();
+    else SetTS();
+}
+
+void FPU::HandleDeviceNotAvailable() {
+    uint32_t cpu = SMP::CpuIndex();
+    FpuState* state = current[cpu];
+    ClearTS();
+    if (!state || (owner[cpu] == state && state->cpu == cpu)) return;
+
+    // Whatever the registers held was saved when its task switched out
+    if (state->initialized) Restore(state, fxsr, avx);
+    else {
+        Reset(sse);
+        for (int i = 512; i < 576; i++) state->image[i] = 0; // XSAVE header: XRSTOR faults on garbage
+        state->initialized = true;
+    }
+    state->cpu = cpu;
+    owner[cpu] = state;
+}
+
+void FPU::Flush() {
+    uint32_t flags = CPU::SaveAndDisableInterrupts();
+    uint32_t cpu = SMP::CpuIndex();
+    // Only the running task's registers can be newer than its saved copy
+    if (owner[cpu] && owner[cpu] == current[cpu]) {
+        ClearTS(); // FXSAVE itself would trap otherwise
+        Save(owner[cpu], fxsr, avx);
+        if (!fxsr) {
+            owner[cpu] = 0;
+            SetTS();
+        }
+    }
+    CPU::RestoreInterrupts(flags);
+}
+
+void FPU::Discard(FpuState* state) {
+    for (uint32_t i = 0; i < MAX_CPUS; i++) {
+        if (owner[i] == state) owner[i] = 0;
+        if (current[i] == state) current[i] = 0;
+    }
+}
+
+uint32_t FPU::KernelBegin() {
+    uint32_t flags;
+    asm volatile("pushf; pop %0; cli" : "=r"(flags) : : "memory");
+
+    uint32_t cpu = SMP::CpuIndex();
+    ClearTS();
+    if (owner[cpu]) {
+        if (owner[cpu] == current[cpu]) Save(owner[cpu], fxsr, avx);
+        owner[cpu] = 0; // Kernel scratch from here on
+    }
+    return flags;
+}
+
+void FPU::KernelEnd(uint32_t flags) {
+    // The running task reloads its registers on its next FPU instruction
+    if (current[SMP::CpuIndex()]) SetTS();
+    asm volatile("push %0; popf" : : "r"(flags) : "memory", "cc");
+}
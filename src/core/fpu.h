@@ -0,0 +1,44 @@
+#ifndef FPU_H
+#define FPU_H
+#include <stdint.h>
+#include "cpu.h"
+
+// x87/SSE register state, switched lazily.
+// Changing tasks only sets CR0.TS; the first FPU/SSE instruction after
+// that raises #NM (vector 7), which loads the new task's registers. Tasks
+// that never touch the FPU never pay.
+// Each CPU has its own registers. A task that used them is saved when it
+// is switched out, since it may resume on another CPU; back on the same
+// CPU with nothing loaded in between, #NM skips the reload.
+
+struct FpuState {
+    uint8_t image[1024];  // XSAVE area (x87+SSE+AVX = 832 bytes); FXSAVE/FSAVE use a prefix
+    bool initialized;     // false: start from a clean FNINIT state
+    uint32_t cpu;         // Where it was last loaded
+} __attribute__((aligned(64)));
+
+class FPU {
+public:
+    static void Init();
+    static bool HasSSE2() { return sse2; }
+    static bool HasAVX() { return avx; }   // YMM state enabled in XCR0
+
+    static void SwitchTo(FpuState* state);  // 0 = kernel only
+    static void HandleDeviceNotAvailable(); // #NM
+    static void Flush();                    // Write live registers back to their owner
+    static void Discard(FpuState* state);   // State is about to be freed
+
+    // Bracket kernel SSE code (graphics kernels). Any live task state is
+    // saved first, and IRQs stay off so a handler cannot clobber XMM regs.
+    static uint32_t KernelBegin();          // Returns EFLAGS for KernelEnd
+    static void KernelEnd(uint32_t flags);
+
+private:
+    static bool fxsr;
+    static bool sse;
+    static bool sse2;
+    static bool avx;
+    static FpuState* owner[MAX_CPUS];   // Whose registers each CPU holds (0 = nobody's)
+    static FpuState* current[MAX_CPUS]; // State of the task running there
+};
+#endif
@@ -1,6 +1,7 @@
 #include "ext4.h"
 #include "../graphics/console.h"
 #include "../mm/kheap.h"
+#include "../mm/slab.h"
 #include "../../utils/StringHelpers.h"
 
 static Ext4Superblock sb;
@@ -9,6 +10,12 @@ static uint32_t block_size = 0;
 
 // VFS Root
 static VirtualFile* vfs_root = 0;
+static SlabCache* vfile_cache = 0;
+
+static VirtualFile* AllocVirtualFile() {
+    if (!vfile_cache) vfile_cache = slab_cache_create("vfs_file", sizeof(VirtualFile), SLAB_CACHE_LINE, 0);
+    return (VirtualFile*)slab_alloc(vfile_cache);
+}
 
 // Helper: Read a Filesystem Block (which might be multiple Disk Sectors)
 void ReadFSBlock(uint32_t block_num, uint8_t* buf) {
@@ -126,7 +133,7 @@ void Ext4::ReadFile(const char* name, char* buf) {
     while(curr) {
         if (!curr->is_dir && Utils::strcmp(curr->name, name) == 0) {
             if (curr->data) {
-                for(int i=0; i<curr->size; i++) buf[i] = curr->data[i];
+                memcpy(buf, curr->data, curr->size);
                 buf[curr->size] = 0;
             } else {
                 buf[0] = 0;
@@ -207,7 +214,8 @@ void Ext4::MkDir(const char* path) {
     // Check dupe
     if (DirExists(path)) return;
 
-    VirtualFile* f = (VirtualFile*)kmalloc(sizeof(VirtualFile));
+    VirtualFile* f = AllocVirtualFile();
+    if (!f) return;
     Utils::strcpy(f->name, path); // TODO: handle full path logic
     f->data = 0;
     f->size = 0;
@@ -225,7 +233,7 @@ void Ext4::Rm(const char* path) {
             else vfs_root = curr->next;
 
             if (curr->data) kfree(curr->data);
-            kfree(curr);
+            slab_free(vfile_cache, curr);
             return;
         }
         prev = curr;
@@ -247,7 +255,8 @@ void Ext4::Touch(const char* path) {
 
     if (exists) return; // Update time?
 
-    VirtualFile* f = (VirtualFile*)kmalloc(sizeof(VirtualFile));
+    VirtualFile* f = AllocVirtualFile();
+    if (!f) return;
     Utils::strcpy(f->name, path);
     f->data = 0;
     f->size = 0;
@@ -264,7 +273,7 @@ void Ext4::WriteFile(const char* filename, const char* data, int size) {
             // Update
             if (curr->data) kfree(curr->data);
             curr->data = (uint8_t*)kmalloc(size);
-            for(int i=0; i<size; i++) curr->data[i] = data[i];
+            memcpy(curr->data, data, size);
             curr->size = size;
             return;
         }
@@ -2,19 +2,25 @@
 
 GlobalDescriptorTable::GlobalDescriptorTable()
     : nullSegmentSelector(0, 0, 0),
-      codeSegmentSelector(0, 64*1024*1024, 0x9A),
-      dataSegmentSelector(0, 64*1024*1024, 0x92),
-      userCodeSegmentSelector(0, 64*1024*1024, 0xFA),
-      userDataSegmentSelector(0, 64*1024*1024, 0xF2),
-      tssSegmentSelector((uint32_t)&tss, sizeof(tss), 0x89) // Type 0x89 = Available 32-bit TSS
+      codeSegmentSelector(0, 0xFFFFFFFF, 0x9A),     // Flat 4GB: paging does the protection,
+      dataSegmentSelector(0, 0xFFFFFFFF, 0x92),     // and the framebuffer lives near 4GB
+      userCodeSegmentSelector(0, 0xFFFFFFFF, 0xFA),
+      userDataSegmentSelector(0, 0xFFFFFFFF, 0xF2)
 {
-    // Initialize TSS fields to 0
-    uint32_t* tss_ptr = (uint32_t*)&tss;
-    for(int i=0; i<sizeof(tss)/4; i++) tss_ptr[i] = 0;
+    for (int cpu = 0; cpu < MAX_CPUS; cpu++) {
+        // Initialize TSS fields to 0
+        uint32_t* tss_ptr = (uint32_t*)&tss[cpu];
+        for(int i=0; i<sizeof(TaskStateSegment)/4; i++) tss_ptr[i] = 0;
 
-    tss.ss0 = 0x10; // Kernel Data Segment
-    tss.esp0 = 0;   // Will be set by kernel before jumping to user mode
-    
+        tss[cpu].ss0 = 0x10; // Kernel Data Segment
+        tss[cpu].esp0 = 0;   // Will be set by kernel before jumping to user mode
+        tssSegmentSelector[cpu].Set((uint32_t)&tss[cpu], sizeof(TaskStateSegment), 0x89); // Type 0x89 = Available 32-bit TSS
+    }
+
+    Load(0); // The boot CPU
+}
+
+void GlobalDescriptorTable::Load(uint32_t cpu) {
     // Setup the GDTR struct (Limit, Base) strictly
     struct {
         uint16_t limit;
@@ -39,12 +45,9 @@ GlobalDescriptorTable::GlobalDescriptorTable()
         : : : "eax" // Clobbers EAX
     );
 
-    // Load Task Register (TSS)
-    // Offset = 0x28 (Index 5)
-    // We must OR 3 if we want to change RPL? No, LTR takes a selector.
-    // DPL of TSS is usually 0. RPL doesn't matter much here, but 0x28|0 or 0x28|3.
-    // Let's us 0x28 (RPL 0).
-    asm volatile("ltr %%ax" : : "a"((uint16_t)0x28));
+    // Load Task Register: each CPU needs its own TSS (LTR marks it busy,
+    // and ESP0 differs per CPU). RPL 0.
+    asm volatile("ltr %%ax" : : "a"((uint16_t)(GDT_TSS_SELECTOR + cpu * 8)));
 }
 
 // REMOVED: Destructor implementation
@@ -66,6 +69,10 @@ uint16_t GlobalDescriptorTable::UserDataSegmentSelector() {
 }
 
 GlobalDescriptorTable::SegmentDescriptor::SegmentDescriptor(uint32_t base, uint32_t limit, uint8_t type) {
+    Set(base, limit, type);
+}
+
+void GlobalDescriptorTable::SegmentDescriptor::Set(uint32_t base, uint32_t limit, uint8_t type) {
     uint8_t* target = (uint8_t*)this;
     if (limit <= 65536) {
         target[6] = 0x40;
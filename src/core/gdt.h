@@ -1,6 +1,10 @@
 #ifndef GDT_H
 #define GDT_H
 #include <stdint.h>
+#include "cpu.h"
+
+// CPU n's TSS sits at GDT_TSS_SELECTOR + 8n (see SMP::CpuIndex)
+#define GDT_TSS_SELECTOR 0x28
 
 class GlobalDescriptorTable {
 public:
@@ -14,7 +18,9 @@ public:
         uint8_t flags_limit_hi;
         uint8_t base_vhi;
         
+        SegmentDescriptor() {}
         SegmentDescriptor(uint32_t base, uint32_t limit, uint8_t type);
+        void Set(uint32_t base, uint32_t limit, uint8_t type);
         uint32_t Base();
         uint32_t Limit();
     } __attribute__((packed));
@@ -29,12 +35,13 @@ private:
     SegmentDescriptor dataSegmentSelector;
     SegmentDescriptor userCodeSegmentSelector;
     SegmentDescriptor userDataSegmentSelector;
-    SegmentDescriptor tssSegmentSelector; // NEW
+    SegmentDescriptor tssSegmentSelector[MAX_CPUS];
 
 public:
-    TaskStateSegment tss; // NEW: Public so kernel can set ESP0
+    TaskStateSegment tss[MAX_CPUS]; // One per CPU: public so the kernel can set ESP0
 
     GlobalDescriptorTable();
+    void Load(uint32_t cpu); // lgdt, reload segments, and take CPU 'cpu''s TSS
     // REMOVED: ~GlobalDescriptorTable(); 
     
     uint16_t CodeSegmentSelector();
@@ -1,6 +1,8 @@
 #include "console.h"
 #include "font.h"
 #include "../mm/kheap.h"
+#include "../../utils/memory.h"
+#include "../../utils/spinlock.h"
 
 #include "console.h"
 #include "font.h"
@@ -11,6 +13,7 @@ static uint32_t screen_width = 0;
 static uint32_t screen_height = 0;
 static uint32_t cursor_x = 0;
 static uint32_t cursor_y = 0;
+static Spinlock print_lock; // Cursor and text: any CPU may print
 
 #include "cursor.h"
 
@@ -78,22 +81,26 @@ void Console::InitDoubleBuffer() {
 void Console::Swap() {
     if (back_buffer == framebuffer) return;
     
-    // Copy RAM -> VRAM
-    // Fast loop
-    uint32_t size = screen_width * screen_height;
-    for(uint32_t i=0; i<size; i++) {
-        framebuffer[i] = back_buffer[i];
-    }
+    // Copy RAM -> VRAM (streaming stores: the frame is never read back)
+    memcpy_nt(framebuffer, back_buffer, screen_width * screen_height * 4);
 }
 
 void Console::Clear(uint32_t color) {
-    for(uint32_t i=0; i < screen_width * screen_height; i++) {
-        back_buffer[i] = color;
-    }
+    memset32(back_buffer, color, screen_width * screen_height);
     cursor_x = 0;
     cursor_y = 0;
 }
 
+void Console::FillRect(int x, int y, int w, int h, uint32_t color) {
+    if (x < 0) { w += x; x = 0; }
+    if (y < 0) { h += y; y = 0; }
+    if (x + w > (int)screen_width) w = screen_width - x;
+    if (y + h > (int)screen_height) h = screen_height - y;
+    if (w <= 0 || h <= 0) return;
+
+    fill_rect32(back_buffer + y * screen_width + x, screen_width, w, h, color);
+}
+
 void Console::PutPixel(int x, int y, uint32_t color) {
     if(x < 0 || x >= (int)screen_width || y < 0 || y >= (int)screen_height) return;
     back_buffer[y * screen_width + x] = color;
@@ -132,22 +139,62 @@ void Console::PutStringAt(const char* str, int x, int y, uint32_t color) {
     }
 }
 
+// A run of glyphs on one text line, scanline by scanline: each pixel row
+// of the run is written left to right in one pass, clipped once per glyph
+// rather than per pixel. Bytes outside the font leave a blank cell.
+static void PutGlyphs(const char* s, uint32_t n, uint32_t color, uint32_t x, uint32_t y) {
+    for (uint32_t fy = 0; fy < 8 && y + fy < screen_height; fy++) {
+        uint32_t* dst = back_buffer + (y + fy) * screen_width + x;
+        for (uint32_t k = 0; k < n; k++, dst += 8) {
+            int index = s[k] - 32;
+            if (index < 0 || index >= 96) continue;
+            uint8_t bits = font8x8_basic[index][fy];
+            if (!bits) continue;
+
+            uint32_t w = screen_width - (x + k * 8);
+            if (w > 8) w = 8;
+            for (uint32_t fx = 0; fx < w; fx++) {
+                if (bits & (0x80 >> fx)) dst[fx] = color;
+            }
+        }
+    }
+}
+
+uint32_t Console::LockText() { return print_lock.LockIrqSave(); }
+void Console::UnlockText(uint32_t flags) { print_lock.UnlockIrqRestore(flags); }
+
 void Console::Print(const char* str) {
-    // Handle newlines and auto-scroll
-    for(int i=0; str[i] != 0; i++) {
-        if(str[i] == '\n') {
+    uint32_t len = 0;
+    while (str[len]) len++;
+    Write(str, len);
+}
+
+void Console::Write(const char* buf, uint32_t len) {
+    SpinlockGuard guard(print_lock);
+    if (!screen_width) return; // Before Init
+
+    uint32_t i = 0;
+    while (i < len) {
+        if (buf[i] == '\n') {
             cursor_x = 0;
             cursor_y += 10; // 8px char + 2px padding
-        } else if (str[i] == '\b') {
+            i++;
+        } else if (buf[i] == '\b') {
             if (cursor_x >= 8) cursor_x -= 8;
             // Draw black box to erase
-            for(int fy=0; fy<8; fy++) 
-                for(int fx=0; fx<8; fx++) 
-                    PutPixel(cursor_x + fx, cursor_y + fy, 0x000080);
+            FillRect(cursor_x, cursor_y, 8, 8, 0x000080);
+            i++;
         } else {
-            PutChar(str[i], 0xFFFFFF, cursor_x, cursor_y);
-            cursor_x += 8;
-            if(cursor_x >= screen_width) {
+            // Everything up to the next control byte or the end of the
+            // line (a cell cut off at the right edge still counts)
+            uint32_t room = (screen_width - cursor_x + 7) / 8;
+            uint32_t n = 0;
+            while (i + n < len && n < room && buf[i + n] != '\n' && buf[i + n] != '\b') n++;
+
+            PutGlyphs(buf + i, n, 0xFFFFFF, cursor_x, cursor_y);
+            cursor_x += n * 8;
+            i += n;
+            if (cursor_x >= screen_width) {
                 cursor_x = 0;
                 cursor_y += 10;
             }
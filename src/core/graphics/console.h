@@ -11,10 +11,16 @@ public:
     static void Swap(); 
     
     static void Clear(uint32_t color);
+    static void FillRect(int x, int y, int w, int h, uint32_t color); // Clipped to the screen
     static void PutPixel(int x, int y, uint32_t color);
     static void PutChar(char c, uint32_t color, uint32_t x, uint32_t y);
     static void PutStringAt(const char* str, int x, int y, uint32_t color);
     static void Print(const char* str);
+    static void Write(const char* buf, uint32_t len); // Print, for a counted buffer
+    // The lock Print/Write hold, for others drawing text into the same
+    // buffer (IRQs off while held: keep it short)
+    static uint32_t LockText();
+    static void UnlockText(uint32_t flags);
     
     // NEW: Mouse Methods
     static void DrawCursor(int x, int y);
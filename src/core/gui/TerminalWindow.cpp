@@ -2,8 +2,25 @@
 #include "../shell/shell.h"
 #include "../shell/Editor.h"
 #include "../graphics/console.h"
+#include "../mm/kheap.h"
+#include "../mm/slab.h"
 #include "../../utils/StringHelpers.h"
 
+static SlabCache* window_cache = 0;
+
+// The cache's slots fit a TerminalWindow exactly: anything derived from it
+// is bigger and comes from the heap (delete gets the same size back)
+void* TerminalWindow::operator new(size_t size) {
+    if (size != sizeof(TerminalWindow)) return kmalloc(size);
+    if (!window_cache) window_cache = slab_cache_create("terminal_window", sizeof(TerminalWindow), SLAB_CACHE_LINE, 0);
+    return slab_alloc(window_cache);
+}
+
+void TerminalWindow::operator delete(void* p, size_t size) {
+    if (size != sizeof(TerminalWindow)) kfree(p);
+    else slab_free(window_cache, p);
+}
+
 TerminalWindow::TerminalWindow(int x, int y, int w, int h, const char* t)
     : Window(x, y, w, h, t)
 {
@@ -115,12 +132,11 @@ void TerminalWindow::Execute() {
 
     // History Logic
     if (history_count < 10) {
-        for(int i=0; i<128; i++) history[history_count][i] = input[i];
+        memcpy(history[history_count], input, 128);
         history_count++;
     } else {
-        for(int j=1; j<10; j++)
-            for(int i=0; i<128; i++) history[j-1][i] = history[j][i];
-        for(int i=0; i<128; i++) history[9][i] = input[i];
+        for(int j=1; j<10; j++) memcpy(history[j-1], history[j], 128);
+        memcpy(history[9], input, 128);
     }
     history_idx = history_count;
 
@@ -1,6 +1,7 @@
 #ifndef TERMINAL_WINDOW_H
 #define TERMINAL_WINDOW_H
 
+#include <stddef.h>
 #include "window.h"
 
 // Forward Declaration to avoid circular dependency
@@ -42,6 +43,10 @@ public:
 
     TerminalWindow(int x, int y, int w, int h, const char* t);
 
+    // Allocated from a dedicated slab cache instead of the generic heap
+    static void* operator new(size_t size);
+    static void operator delete(void* p, size_t size);
+
     void Clear();
     void Prompt();
     void Scroll();
@@ -6,12 +6,22 @@
 #include "../graphics/cursor.h"
 #include "../../drivers/rtc.h"
 #include "../../drivers/keyboard.h"
+#include "../clock.h"
+#include "../timer.h"
+#include "input.h"
+
+#define CLOCK_REFRESH_MS 1000 // Taskbar clock check
 
 // --- State ---
 static Window* windows[10];
 static int window_count = 0;
 static Window* active_window = 0;
 static int mouse_x = 400, mouse_y = 300;
+static uint8_t mouse_buttons = 0;
+static bool dirty = false;       // Something changed since the last Draw()
+static uint32_t input_latency_us = 0;
+static Timer clock_timer;
+static uint8_t shown_minute = 0xFF; // On the taskbar clock
 
 // GUI State
 static bool show_start_menu = false;
@@ -21,9 +31,14 @@ static int drag_offset_y = 0;
 
 // --- Drawing Helpers ---
 void DrawRect(int x, int y, int w, int h, uint32_t col) {
-    for(int j=0; j<h; j++)
-        for(int i=0; i<w; i++)
-            Console::PutPixel(x+i, y+j, col);
+    Console::FillRect(x, y, w, h, col);
+}
+
+// Text goes in under the console's lock, as Console::Print's does
+static void DrawText(const char* text, int x, int y, uint32_t col) {
+    uint32_t flags = Console::LockText();
+    Console::PutStringAt(text, x, y, col);
+    Console::UnlockText(flags);
 }
 
 // Draw a "3D" Button
@@ -40,7 +55,7 @@ void DrawButton(int x, int y, int w, int h, const char* text, bool pressed) {
     DrawRect(x, y+h-1, w, 1, shadow); // Bottom
     DrawRect(x+w-1, y, 1, h, shadow); // Right
     
-    Console::PutStringAt(text, x + 10, y + 8, 0x000000);
+    DrawText(text, x + 10, y + 8, 0x000000);
 }
 
 // --- Main Logic ---
@@ -56,6 +71,62 @@ void Desktop::Init() {
     Draw();
 }
 
+#define INPUT_BATCH 32 // Events taken off the queue at a time
+
+// PS/2 reports motion, and the button state as a whole: the handlers want
+// a position and the edges
+static void ApplyMouse(const InputEvent& e) {
+    int x = mouse_x + e.dx, y = mouse_y + e.dy;
+    if (x < 0) x = 0;
+    if (y < 0) y = 0;
+    if (x >= 799) x = 799;
+    if (y >= 599) y = 599;
+    if (x != mouse_x || y != mouse_y) Desktop::OnMouseMove(x, y);
+
+    uint8_t changed = e.buttons ^ mouse_buttons;
+    mouse_buttons = e.buttons;
+    if (changed & 1) {
+        if (e.buttons & 1) Desktop::OnMouseDown(1);
+        else Desktop::OnMouseUp(1);
+    }
+}
+
+// IRQ0: a wakeup through the event queue, so the clock keeps up without input
+static void ClockTimer(void*) {
+    InputQueue::Push(INPUT_TIMER, 0);
+    TimerWheel::Add(&clock_timer, CLOCK_REFRESH_MS, ClockTimer, 0);
+}
+
+// The compositor thread: the IRQ handlers only queue events. Everything
+// queued is applied in order, and then the screen is repainted once, so a
+// burst of mouse packets during a drag costs one frame, not one per packet.
+void Desktop::Run(void*) {
+    InputEvent events[INPUT_BATCH];
+    TimerWheel::Add(&clock_timer, CLOCK_REFRESH_MS, ClockTimer, 0);
+    for (;;) {
+        uint32_t n = InputQueue::Wait(events, INPUT_BATCH);
+        uint64_t oldest = events[0].time_ns;
+        do {
+            for (uint32_t i = 0; i < n; i++) {
+                const InputEvent& e = events[i];
+                if (e.type == INPUT_KEY_DOWN) OnKeyDown(e.scancode);
+                else if (e.type == INPUT_KEY_UP) OnKeyUp(e.scancode);
+                else if (e.type == INPUT_MOUSE) ApplyMouse(e);
+                else if (RTC::GetMinute() != shown_minute) dirty = true;
+            }
+            n = InputQueue::Pop(events, INPUT_BATCH); // Whatever came in meanwhile too
+        } while (n);
+
+        if (dirty) {
+            dirty = false;
+            Draw();
+            input_latency_us = (uint32_t)udiv64(Clock::Nanoseconds() - oldest, 1000, 0);
+        }
+    }
+}
+
+uint32_t Desktop::InputLatencyUs() { return input_latency_us; }
+
 void Desktop::AddWindow(Window* w) {
     if(window_count < 10) windows[window_count++] = w;
     active_window = w; // Auto-focus new windows
@@ -77,10 +148,10 @@ void Desktop::Draw() {
         
         // Title Text (White) - Simple Hack: Draw 3 chars
         // (Real text rendering needs the previous step's font logic)
-        Console::PutChar('X', 0xFFFFFF, w->x + w->width - 15, w->y + 5); // Close Button
+        DrawText("X", w->x + w->width - 15, w->y + 5, 0xFFFFFF); // Close Button
         
         // Draw Title
-        Console::PutStringAt(w->title, w->x + 5, w->y + 6, 0xFFFFFF);
+        DrawText(w->title, w->x + 5, w->y + 6, 0xFFFFFF);
 
         // Body (White)
         DrawRect(w->x, w->y+20, w->width, w->height-20, 0xFFFFFF);
@@ -113,7 +184,8 @@ void Desktop::Draw() {
     timeStr[4] = '0' + (m % 10);
     timeStr[5] = 0;
     
-    Console::PutStringAt(timeStr, 800-70, taskbar_y+11, 0x00FF00);
+    DrawText(timeStr, 800-70, taskbar_y+11, 0x00FF00);
+    shown_minute = m;
 
     // 6. Start Menu (Popup)
     if (show_start_menu) {
@@ -122,7 +194,7 @@ void Desktop::Draw() {
         DrawRect(2, menu_y+2, 146, 146, 0xFFFFFF); // Inner
         DrawRect(2, menu_y+2, 20, 146, 0x000080); // Side Stripe
         
-        Console::PutStringAt("Shutdown", 30, menu_y + 120, 0x000000);
+        DrawText("Shutdown", 30, menu_y + 120, 0x000000);
     }
 
     // 7. Mouse
@@ -138,7 +210,7 @@ void Desktop::OnMouseDown(int btn) {
         if (mouse_y > 560) { 
             if (mouse_x < 90) { // Start Button
                 show_start_menu = !show_start_menu;
-                Draw();
+                dirty = true;
                 return;
             }
         }
@@ -158,7 +230,7 @@ void Desktop::OnMouseDown(int btn) {
                     drag_offset_x = mouse_x - w->x;
                     drag_offset_y = mouse_y - w->y;
                 }
-                Draw(); // Redraw to show active color change
+                dirty = true; // Redraw to show active color change
                 return;
             }
         }
@@ -176,14 +248,9 @@ void Desktop::OnMouseMove(int x, int y) {
     if (drag_window) {
         drag_window->x = mouse_x - drag_offset_x;
         drag_window->y = mouse_y - drag_offset_y;
-        Draw(); // Redraw only on drag
-        return;
     }
-    
-    // Optimization: Don't redraw whole desktop on every mouse move if not dragging
-    // But we need to update cursor cursor.
-    // For now, simple Draw() is safest to ensure no artifacts.
-    Draw();
+    // The cursor moved: redrawn with everything else once the queue is drained
+    dirty = true;
 }
 
 // Input State
@@ -204,6 +271,6 @@ void Desktop::OnKeyDown(int scancode) {
         char c = Keyboard::ScancodeToAscii(scancode);
         // Pass BOTH scancode (for arrows) and ascii (for text)
         active_window->OnKeyDown(scancode, c);
-        Draw();
+        dirty = true;
     }
 }
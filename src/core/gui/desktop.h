@@ -1,11 +1,14 @@
 #ifndef DESKTOP_H
 #define DESKTOP_H
+#include <stdint.h>
 #include "window.h"
 
 class Desktop {
 public:
     static void Init();
     static void Draw();
+    static void Run(void*); // Compositor thread: input events in, frames out
+    static uint32_t InputLatencyUs(); // Oldest event of the last frame to its present
     static void OnMouseMove(int x, int y);
     static void OnMouseDown(int btn);
     static void OnMouseUp(int btn);
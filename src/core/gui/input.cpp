@@ -0,0 +1,48 @@
+#include "input.h"
+#include "../clock.h"
+#include "../cpu.h"
+
+MpscRing<InputEvent, INPUT_QUEUE_SIZE> InputQueue::ring;
+volatile bool InputQueue::waiting = false;
+uint32_t InputQueue::dropped = 0;
+WaitQueue InputQueue::consumer;
+
+bool InputQueue::Push(uint8_t type, uint8_t scancode, uint8_t buttons, int16_t dx, int16_t dy) {
+    InputEvent e;
+    e.time_ns = Clock::Nanoseconds();
+    e.type = type;
+    e.scancode = scancode;
+    e.buttons = buttons;
+    e.dx = dx;
+    e.dy = dy;
+    if (!ring.Push(e)) {
+        __sync_fetch_and_add(&dropped, 1);
+        return false;
+    }
+
+    // Published: wake the consumer if it went (or is going) to sleep
+    __sync_synchronize();
+    if (waiting) {
+        SpinlockGuard guard(consumer.lock);
+        waiting = false;
+        consumer.WakeAll();
+    }
+    return true;
+}
+
+uint32_t InputQueue::Pop(InputEvent* out, uint32_t max) { return ring.PopBatch(out, max); }
+
+uint32_t InputQueue::Wait(InputEvent* out, uint32_t max) {
+    for (;;) {
+        uint32_t n = ring.PopBatch(out, max);
+        if (n) return n;
+
+        InterruptGuard guard;
+        consumer.lock.Lock();
+        waiting = true;
+        __sync_synchronize(); // Announced before the last look
+        if (ring.Empty()) consumer.Wait();
+        waiting = false;
+        consumer.lock.Unlock();
+    }
+}
@@ -0,0 +1,47 @@
+#ifndef INPUT_H
+#define INPUT_H
+#include <stdint.h>
+#include "../proc/waitqueue.h"
+#include "../../utils/ring.h"
+
+// Input Event Queue (IRQ bottom half)
+// The keyboard and mouse handlers only decode and queue a timestamped
+// event; the compositor thread (Desktop::Run) drains them and repaints.
+// The ring is an MpscRing: device IRQs may be routed to different CPUs,
+// and none of them ever waits for another. A full ring drops new events.
+//
+// Only the consumer ever sleeps. It announces that in 'waiting' before
+// its last look at the ring, so a producer takes the wait queue's lock
+// only when there is someone to wake.
+
+#define INPUT_QUEUE_SIZE 256 // Power of two
+
+enum InputEventType {
+    INPUT_KEY_DOWN,
+    INPUT_KEY_UP,
+    INPUT_MOUSE,    // Motion and/or a button change
+    INPUT_TIMER     // Not input: the compositor's periodic clock check
+};
+
+struct InputEvent {
+    uint64_t time_ns;  // Clock::Nanoseconds() when the IRQ queued it
+    uint8_t type;      // InputEventType
+    uint8_t scancode;  // Keys (set 1, release bit stripped)
+    uint8_t buttons;   // Mouse: bit 0 left, 1 right, 2 middle
+    int16_t dx, dy;    // Mouse: motion, y growing downwards
+};
+
+class InputQueue {
+public:
+    static bool Push(uint8_t type, uint8_t scancode, uint8_t buttons = 0, int16_t dx = 0, int16_t dy = 0); // IRQ context
+    static uint32_t Pop(InputEvent* out, uint32_t max); // Consumer: up to 'max' events, 0 if none
+    static uint32_t Wait(InputEvent* out, uint32_t max); // Consumer: Pop, sleeping until there is one
+    static uint32_t Dropped() { return dropped; }
+
+private:
+    static MpscRing<InputEvent, INPUT_QUEUE_SIZE> ring;
+    static volatile bool waiting;
+    static uint32_t dropped;
+    static WaitQueue consumer;
+};
+#endif
@@ -1,17 +1,36 @@
 #include "interrupts.h"
 #include "../drivers/keyboard.h"
 #include "../drivers/mouse.h"
-#include "../core/gui/desktop.h"
-#include "graphics/console.h"
+#include "../drivers/pit.h"
+#include "../core/gui/input.h"
+#include "paging.h"
+#include "proc/scheduler.h"
+#include "fpu.h"
+#include "lapic.h"
+#include "ioapic.h"
+#include "smp.h"
+#include "syscall.h"
+#include "sysinfo.h"
+#include "timer.h"
 
 extern "C" void _ZN16InterruptManager22IgnoreInterruptRequestEv();
 extern "C" void _ZN16InterruptManager26HandleInterruptRequest32Ev();
 extern "C" void _ZN16InterruptManager26HandleInterruptRequest33Ev();
 extern "C" void _ZN16InterruptManager26HandleInterruptRequest44Ev(); // Mouse (IRQ 12)
+extern "C" void _ZN16InterruptManager26HandleInterruptRequest64Ev(); // LAPIC timer (0x40)
+extern "C" void _ZN16InterruptManager26HandleInterruptRequest65Ev(); // Reschedule IPI (0x41)
 extern "C" void _ZN16InterruptManager26HandleInterruptRequest128Ev(); // Syscall (0x80)
+extern "C" void _ZN16InterruptManager26HandleInterruptRequest129Ev(); // Yield (0x81)
 extern "C" void _ZN16InterruptManager26HandleInterruptRequest14Ev();  // Page Fault (14)
+extern "C" void _ZN16InterruptManager26HandleInterruptRequest7Ev();   // Device Not Available (7)
+
+#define PIC_READ_IRR 0x0A // OCW3
 
 InterruptManager::GateDescriptor InterruptManager::interruptDescriptorTable[256];
+bool InterruptManager::ioapic_mode = false;
+
+// Device IRQs with a handler: Timer, Keyboard, Mouse
+static const uint8_t device_irqs[] = { 0, 1, 12 };
 
 void InterruptManager::WritePort(uint16_t port, uint8_t data) {
     asm volatile("outb %0, %1" : : "a"(data), "Nd"(port));
@@ -53,6 +72,34 @@ void InterruptManager::RemapPIC() {
     WritePort(0xA1, 0xEF);
 }
 
+bool InterruptManager::EnableIOAPIC() {
+    if (!ACPI::HasMadt() || !LAPIC::Init() || !IOAPIC::Init()) return false;
+    InterruptGuard guard;
+
+    // Silence the 8259s first, so no IRQ is taken twice during the switch
+    WritePort(0x21, 0xFF);
+    WritePort(0xA1, 0xFF);
+    LAPIC::MaskLegacy();
+
+    uint8_t boot_cpu = LAPIC::Id();
+    for (uint32_t i = 0; i < sizeof(device_irqs); i++)
+        IOAPIC::RouteIsa(device_irqs[i], 0x20 + device_irqs[i], boot_cpu);
+    ioapic_mode = true;
+    return true;
+}
+
+bool InterruptManager::SetAffinity(uint8_t irq, uint32_t cpu) {
+    if (!ioapic_mode || irq == 0 || cpu >= SMP::CpuCount()) return false;
+    return IOAPIC::SetIsaDestination(irq, SMP::ApicId(cpu));
+}
+
+bool InterruptManager::IrqPending(uint8_t irq) {
+    if (ioapic_mode) return LAPIC::Pending(0x20 + irq);
+    uint16_t port = irq < 8 ? 0x20 : 0xA0;
+    WritePort(port, PIC_READ_IRR);
+    return (ReadPort(port) >> (irq & 7)) & 1;
+}
+
 void InterruptManager::SetInterruptDescriptorTableEntry(uint8_t interrupt, uint16_t codeSegmentSelectorOffset, void (*handler)(), uint8_t DescriptorPrivilegeLevel, uint8_t DescriptorType) {
     interruptDescriptorTable[interrupt].handlerAddressLowBits = ((uint32_t)handler) & 0xFFFF;
     interruptDescriptorTable[interrupt].handlerAddressHighBits = (((uint32_t)handler) >> 16) & 0xFFFF;
@@ -79,9 +126,23 @@ InterruptManager::InterruptManager(GlobalDescriptorTable* gdt) {
     // Syscall (0x80) - CRITICAL: DPL=3 so Ring 3 can call it
     SetInterruptDescriptorTableEntry(0x80, CodeSegment, &_ZN16InterruptManager26HandleInterruptRequest128Ev, 3, IDT_INTERRUPT_GATE);
 
+    // Yield (0x81): kernel threads only, so DPL=0
+    SetInterruptDescriptorTableEntry(SCHED_YIELD_VECTOR, CodeSegment, &_ZN16InterruptManager26HandleInterruptRequest129Ev, 0, IDT_INTERRUPT_GATE);
+
+    // Device Not Available (7): first FPU/SSE use after a task switch
+    SetInterruptDescriptorTableEntry(7, CodeSegment, &_ZN16InterruptManager26HandleInterruptRequest7Ev, 0, IDT_INTERRUPT_GATE);
+
     // Page Fault (14)
     SetInterruptDescriptorTableEntry(14, CodeSegment, &_ZN16InterruptManager26HandleInterruptRequest14Ev, 0, IDT_INTERRUPT_GATE);
 
+    // Local APIC: per-CPU tick and cross-CPU wakeups (spurious 0xFF stays ignored)
+    SetInterruptDescriptorTableEntry(LAPIC_TIMER_VECTOR, CodeSegment, &_ZN16InterruptManager26HandleInterruptRequest64Ev, 0, IDT_INTERRUPT_GATE);
+    SetInterruptDescriptorTableEntry(LAPIC_RESCHED_VECTOR, CodeSegment, &_ZN16InterruptManager26HandleInterruptRequest65Ev, 0, IDT_INTERRUPT_GATE);
+
+    LoadIDT();
+}
+
+void InterruptManager::LoadIDT() {
     InterruptDescriptorTablePointer idt;
     idt.size = 256 * sizeof(GateDescriptor) - 1;
     idt.base = (uint32_t)interruptDescriptorTable;
@@ -94,8 +155,21 @@ void InterruptManager::Activate() { asm volatile("sti"); }
 
 uint32_t InterruptManager::HandleInterrupt(uint8_t interrupt, uint32_t esp) {
     
+    // Device Not Available (7)
+    if (interrupt == 7) {
+        FPU::HandleDeviceNotAvailable();
+        return esp;
+    }
+
     // Page Fault (14)
     if (interrupt == 14) {
+        uint32_t fault_addr;
+        asm volatile("mov %%cr2, %0" : "=r"(fault_addr));
+
+        // Demand-paged region (user heap/stack): map a zeroed frame and retry
+        uint32_t error_code = ((uint32_t*)esp)[8];
+        if (PageTableManager::HandlePageFault(fault_addr, error_code)) return esp;
+
         // Hardcode Print for Panic
         uint16_t* vid = (uint16_t*)0xB8000;
         char msg[] = "PANIC: PAGE FAULT ADDR: 0x";
@@ -117,76 +191,13 @@ uint32_t InterruptManager::HandleInterrupt(uint8_t interrupt, uint32_t esp) {
     }
     
     
-    // Global tracker for User Heap End (Starts at 8MB mark)
-    // In a real OS, this would be inside a 'Process' struct.
-    static uint32_t user_heap_end = 0x800000; 
-
-    if (interrupt == 0x80) { // SYSCALL
-        uint32_t* stack = (uint32_t*)esp;
-        
-        // Extract Registers
-        uint32_t eax = stack[7]; // Syscall Number
-        uint32_t ebx = stack[4]; // Arg 1
-        uint32_t ecx = stack[6]; // Arg 2 (Note: pushad order puts ECX at index 6)
-        uint32_t edx = stack[5]; // Arg 3
-
-        // Syscall 4: WRITE (Linux Standard)
-        // ebx = file (ignore), ecx = buffer, edx = count
-        if (eax == 4) {
-            char* str = (char*)ecx;
-            // We need to null-terminate the buffer safely or loop manually
-            // The Console::Print expects a null-terminated string.
-            // Let's loop manually to be safe with the 'edx' count.
-            
-            char safe_buf[2] = {0, 0};
-            for(uint32_t i=0; i<edx; i++) {
-                 safe_buf[0] = str[i];
-                 Console::Print(safe_buf);
-            }
-        }
-        
-        // Syscall 3: READ (Linux Standard)
-        // Returns char in EAX
-        else if (eax == 3) {
-            // Blocking Read
-            // We MUST enable interrupts to receive the keypress!
-            asm volatile("sti");
-            
-            char c = 0;
-            while(c == 0) {
-                c = Keyboard::GetChar();
-                // Optional: Add 'halt' here to save CPU, but busy wait is fine for now
-            }
-            
-            asm volatile("cli"); // Disable again before returning (IRET will restore state anyway, but cleaner)
-            stack[7] = c; // Put result back into EAX on stack
-        }
-
-        // Syscall 45: BRK / SBRK (Heap Allocation)
-        // ebx = increment amount (bytes)
-        // Returns: Pointer to OLD break (start of new block)
-        else if (eax == 45) {
-            uint32_t old_break = user_heap_end;
-            user_heap_end += ebx;
-            
-            // Safety: Check if we exceed mapped memory (128MB)
-            if (user_heap_end >= 128*1024*1024) {
-                    user_heap_end = old_break; // Rollback
-                    stack[7] = 0; // Return NULL
-            } else {
-                    stack[7] = old_break; // Return pointer
-            }
-        }
-
-        // Syscall 88: REBOOT
-        else if (eax == 88) {
-            // Pulse the Keyboard Controller to reset CPU
-            uint8_t good = 0x02;
-            while (good & 0x02)
-                good = ReadPort(0x64);
-            WritePort(0x64, 0xFE);
-            // CPU halts here and reboots
-        }
+    if (interrupt == 0x80) { // SYSCALL (the SYSENTER fast path ends up in the same table)
+        Syscall::Dispatch((TrapFrame*)esp);
+    }
+    else if (interrupt == 0x20) { // Timer (IRQ 0)
+        // Several at once after a tickless idle
+        for (uint32_t n = PIT::HandleInterrupt(); n; n--) TimerWheel::Tick();
+        SysInfo::Update();
     }
     else if (interrupt == 0x21) { // Keyboard
         uint8_t scancode = ReadPort(0x60);
@@ -194,26 +205,40 @@ uint32_t InterruptManager::HandleInterrupt(uint8_t interrupt, uint32_t esp) {
         // Check if Key Release (Bit 7 set = 0x80)
         if (scancode & 0x80) {
              // Release Event
-             Desktop::OnKeyUp(scancode & 0x7F);
+             InputQueue::Push(INPUT_KEY_UP, scancode & 0x7F);
         } else {
              // Press Event
              // Update Keyboard driver state for syscalls/others if needed
              if (scancode < 0x80) {
                  char c = Keyboard::ScancodeToAscii(scancode);
-                 if(c!=0) Keyboard::lastKey = c;
+                 if(c!=0) Keyboard::Push(c);
              }
-             Desktop::OnKeyDown(scancode);
+             InputQueue::Push(INPUT_KEY_DOWN, scancode); // Drawn by the compositor
         }
     }
     else if (interrupt == 0x2C || interrupt == 44) { // Mouse (IRQ 12 = 0x20 + 12 = 0x2C)
         Mouse::HandleInterrupt();
     }
 
-    // Acknowledge Interrupt (EOI) to PIC
+    // Acknowledge Interrupt (EOI): device IRQs at the local APIC once the
+    // I/O APIC routes them, else to the PIC
     if (interrupt >= 0x20 && interrupt < 0x30) {
-        WritePort(0x20, 0x20); // Ack Master
-        if (interrupt >= 0x28) WritePort(0xA0, 0x20); // Ack Slave
+        if (ioapic_mode) {
+            LAPIC::EOI();
+        } else {
+            WritePort(0x20, 0x20); // Ack Master
+            if (interrupt >= 0x28) WritePort(0xA0, 0x20); // Ack Slave
+        }
     }
-    
+
+    // Acknowledge to the local APIC (its timer, IPIs)
+    if (interrupt == LAPIC_TIMER_VECTOR || interrupt == LAPIC_RESCHED_VECTOR) LAPIC::EOI();
+
+    // Preemption (timer) or an explicit yield: maybe resume another thread.
+    // A reschedule IPI only means "your run queue has work".
+    bool tick = interrupt == 0x20 || interrupt == LAPIC_TIMER_VECTOR;
+    if (tick || interrupt == SCHED_YIELD_VECTOR || interrupt == LAPIC_RESCHED_VECTOR)
+        return Scheduler::Schedule(esp, tick);
+
     return esp;
 }
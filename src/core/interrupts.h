@@ -24,13 +24,28 @@ protected:
 
     static void Port8BitSlow(uint16_t port, uint8_t data);
 
+    static bool ioapic_mode; // Device IRQs come through the I/O APIC, not the 8259s
+
 public:
     InterruptManager(GlobalDescriptorTable* gdt);
     ~InterruptManager();
     void Activate();
+    static void LoadIDT(); // On each CPU (the table is shared)
     
     static uint32_t HandleInterrupt(uint8_t interrupt, uint32_t esp);
     static void RemapPIC();
+
+    // Move the device IRQs from the 8259s to the I/O APIC (same vectors,
+    // all on the boot CPU to begin with). Needs the MADT and IRQs on (the
+    // local APIC timer is calibrated); false = the PIC stays in charge.
+    static bool EnableIOAPIC();
+    static bool UsingIOAPIC() { return ioapic_mode; }
+    // Deliver ISA 'irq' to CPU index 'cpu' from now on (I/O APIC only).
+    // IRQ 0 stays on the boot CPU, which keeps the timers.
+    static bool SetAffinity(uint8_t irq, uint32_t cpu);
+    // Raised but not yet serviced, for code running with IRQs off. Through
+    // the I/O APIC, only the CPU the IRQ is routed to can tell.
+    static bool IrqPending(uint8_t irq);
     
     // Port I/O Wrappers (Needed for PIC)
     static void WritePort(uint16_t port, uint8_t data);
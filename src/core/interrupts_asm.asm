@@ -1,6 +1,7 @@
 [BITS 32]
 section .text
 extern _ZN16InterruptManager15HandleInterruptEhj ; Name mangling for HandleInterrupt
+extern _ZN9Scheduler12FinishSwitchEv             ; Scheduler::FinishSwitch
 global _ZN16InterruptManager22IgnoreInterruptRequestEv
 
 ; Macro for simple interrupt handler
@@ -15,6 +16,7 @@ _ZN16InterruptManager26HandleInterruptRequest%1Ev:
     call _ZN16InterruptManager15HandleInterruptEhj
     
     mov esp, eax     ; Restore Stack (EAX returned by C++)
+    call _ZN9Scheduler12FinishSwitchEv ; Off the old thread's stack now
     popad
     iretd
 %endmacro
@@ -32,6 +34,7 @@ _ZN16InterruptManager26HandleInterruptRequest%1Ev:
     call _ZN16InterruptManager15HandleInterruptEhj
     
     mov esp, eax
+    call _ZN9Scheduler12FinishSwitchEv
     popad
     
     add esp, 4 ; Pop Error Code
@@ -49,6 +52,10 @@ HandleInterruptRequest 33
 ; IRQ 12 - Mouse
 HandleInterruptRequest 44
 
+; Local APIC timer (0x40) and reschedule IPI (0x41)
+HandleInterruptRequest 64
+HandleInterruptRequest 65
+
 ; PIC Spurious Interrupts (Ignore)
 HandleInterruptRequest 39
 HandleInterruptRequest 47
@@ -56,6 +63,12 @@ HandleInterruptRequest 47
 ; SYSCALL (0x80 = 128)
 HandleInterruptRequest 128
 
+; Yield (0x81 = 129): a kernel thread gives up the CPU
+HandleInterruptRequest 129
+
+; Device Not Available (7): lazy FPU/SSE state switch
+HandleInterruptRequest 7
+
 ; Page Fault (14)
 HandleException 14
 
@@ -0,0 +1,113 @@
+#include "ioapic.h"
+#include "paging.h"
+#include "../utils/spinlock.h"
+
+#define IOREGSEL      0x00 // Register select (byte offsets; regs[] is in words)
+#define IOWIN         0x10 // Data window
+
+#define IOAPIC_VER    0x01
+#define IOAPIC_REDTBL 0x10 // Two registers per input: low, then high
+
+// Redirection entry, low half (high half: destination APIC ID in bits 24-31)
+#define RED_ACTIVE_LOW 0x2000
+#define RED_LEVEL      0x8000
+#define RED_MASKED     0x10000
+
+IOAPIC::Chip IOAPIC::chips[ACPI_MAX_IOAPICS];
+uint32_t IOAPIC::count = 0;
+
+// Register select and window are one pair per chip; any CPU may reroute
+static Spinlock ioapic_lock;
+
+uint32_t IOAPIC::Read(Chip* chip, uint32_t reg) {
+    chip->regs[IOREGSEL / 4] = reg;
+    return chip->regs[IOWIN / 4];
+}
+
+void IOAPIC::Write(Chip* chip, uint32_t reg, uint32_t value) {
+    chip->regs[IOREGSEL / 4] = reg;
+    chip->regs[IOWIN / 4] = value;
+}
+
+bool IOAPIC::Init() {
+    for (uint32_t i = 0; i < ACPI::IoApicCount(); i++) {
+        const AcpiIoApic* io = ACPI::IoApic(i);
+        if (!PageTableManager::MapRange(io->address, io->address, PAGE_SIZE, PAGE_WRITE | PAGE_NO_CACHE | PAGE_GLOBAL, "ioapic"))
+            continue;
+
+        Chip* chip = &chips[count++];
+        chip->regs = (volatile uint32_t*)io->address;
+        chip->gsi_base = io->gsi_base;
+        chip->inputs = ((Read(chip, IOAPIC_VER) >> 16) & 0xFF) + 1;
+
+        for (uint32_t pin = 0; pin < chip->inputs; pin++) {
+            Write(chip, IOAPIC_REDTBL + pin * 2, RED_MASKED);
+            Write(chip, IOAPIC_REDTBL + pin * 2 + 1, 0);
+        }
+    }
+    return count != 0;
+}
+
+bool IOAPIC::Find(uint32_t gsi, Chip** chip, uint32_t* pin) {
+    for (uint32_t i = 0; i < count; i++) {
+        if (gsi >= chips[i].gsi_base && gsi - chips[i].gsi_base < chips[i].inputs) {
+            *chip = &chips[i];
+            *pin = gsi - chips[i].gsi_base;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool IOAPIC::RouteIsa(uint8_t irq, uint8_t vector, uint8_t apic_id) {
+    uint32_t flags;
+    uint32_t gsi = ACPI::IsaGsi(irq, &flags);
+    Chip* chip;
+    uint32_t pin;
+    if (!Find(gsi, &chip, &pin)) return false;
+
+    uint32_t low = vector; // Fixed delivery, physical destination
+    if (flags & ACPI_IRQ_ACTIVE_LOW) low |= RED_ACTIVE_LOW;
+    if (flags & ACPI_IRQ_LEVEL) low |= RED_LEVEL;
+
+    SpinlockGuard guard(ioapic_lock);
+    Write(chip, IOAPIC_REDTBL + pin * 2 + 1, (uint32_t)apic_id << 24);
+    Write(chip, IOAPIC_REDTBL + pin * 2, low);
+    return true;
+}
+
+void IOAPIC::MaskIsa(uint8_t irq, bool masked) {
+    uint32_t flags;
+    Chip* chip;
+    uint32_t pin;
+    if (!Find(ACPI::IsaGsi(irq, &flags), &chip, &pin)) return;
+
+    SpinlockGuard guard(ioapic_lock);
+    uint32_t low = Read(chip, IOAPIC_REDTBL + pin * 2);
+    Write(chip, IOAPIC_REDTBL + pin * 2, masked ? (low | RED_MASKED) : (low & ~RED_MASKED));
+}
+
+bool IOAPIC::SetIsaDestination(uint8_t irq, uint8_t apic_id) {
+    uint32_t flags;
+    Chip* chip;
+    uint32_t pin;
+    if (!Find(ACPI::IsaGsi(irq, &flags), &chip, &pin)) return false;
+
+    // Takes effect from the next interrupt; one in flight still lands on the old CPU
+    SpinlockGuard guard(ioapic_lock);
+    Write(chip, IOAPIC_REDTBL + pin * 2 + 1, (uint32_t)apic_id << 24);
+    return true;
+}
+
+bool IOAPIC::IsaRoute(uint8_t irq, uint8_t* vector, uint8_t* apic_id) {
+    uint32_t flags;
+    Chip* chip;
+    uint32_t pin;
+    if (!Find(ACPI::IsaGsi(irq, &flags), &chip, &pin)) return false;
+
+    SpinlockGuard guard(ioapic_lock);
+    uint32_t low = Read(chip, IOAPIC_REDTBL + pin * 2);
+    *vector = low & 0xFF;
+    *apic_id = Read(chip, IOAPIC_REDTBL + pin * 2 + 1) >> 24;
+    return !(low & RED_MASKED);
+}
@@ -0,0 +1,37 @@
+#ifndef IOAPIC_H
+#define IOAPIC_H
+#include <stdint.h>
+#include "acpi.h"
+
+// I/O APIC: routes device interrupt inputs (global system interrupts) to
+// a vector on a chosen CPU's local APIC, which takes the EOI. Replaces the
+// 8259 pair when the MADT describes one. ISA IRQs are addressed by their
+// IRQ number; the MADT's overrides say which input and signalling each
+// one really uses.
+
+class IOAPIC {
+public:
+    static bool Init(); // Map every I/O APIC from the MADT, all inputs masked. false = none
+    static bool Present() { return count != 0; }
+
+    // Deliver ISA 'irq' as 'vector' to the CPU with local APIC 'apic_id', unmasked
+    static bool RouteIsa(uint8_t irq, uint8_t vector, uint8_t apic_id);
+    static void MaskIsa(uint8_t irq, bool masked);
+    static bool SetIsaDestination(uint8_t irq, uint8_t apic_id);
+    static bool IsaRoute(uint8_t irq, uint8_t* vector, uint8_t* apic_id); // false = masked/none
+
+private:
+    struct Chip {
+        volatile uint32_t* regs;
+        uint32_t gsi_base;
+        uint32_t inputs;
+    };
+
+    static bool Find(uint32_t gsi, Chip** chip, uint32_t* pin);
+    static uint32_t Read(Chip* chip, uint32_t reg);
+    static void Write(Chip* chip, uint32_t reg, uint32_t value);
+
+    static Chip chips[ACPI_MAX_IOAPICS];
+    static uint32_t count;
+};
+#endif
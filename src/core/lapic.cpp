@@ -0,0 +1,128 @@
+#include "lapic.h"
+#include "cpu.h"
+#include "clock.h"
+#include "paging.h"
+
+#define IA32_APIC_BASE    0x1B
+#define APIC_BASE_ENABLE  0x800
+
+// Register offsets
+#define LAPIC_ID          0x020
+#define LAPIC_TPR         0x080
+#define LAPIC_EOI         0x0B0
+#define LAPIC_SVR         0x0F0
+#define LAPIC_ICR_LO      0x300
+#define LAPIC_ICR_HI      0x310
+#define LAPIC_IRR         0x200 // Eight 32-bit words, 16 bytes apart
+#define LAPIC_LVT_TIMER   0x320
+#define LAPIC_LVT_LINT0   0x350
+#define LAPIC_LVT_ERROR   0x370
+#define LAPIC_TIMER_INIT  0x380
+#define LAPIC_TIMER_COUNT 0x390
+#define LAPIC_TIMER_DIV   0x3E0
+
+#define SVR_ENABLE        0x100
+#define LVT_MASKED        0x10000
+#define TIMER_PERIODIC    0x20000
+#define TIMER_DIV_16      0x3
+
+// Interrupt Command Register
+#define ICR_FIXED         0x000
+#define ICR_INIT          0x500
+#define ICR_STARTUP       0x600
+#define ICR_PENDING       0x1000
+#define ICR_ASSERT        0x4000
+#define ICR_ALL_BUT_SELF  0xC0000
+
+#define CALIBRATE_US      10000
+
+volatile uint32_t* LAPIC::regs = 0;
+uint32_t LAPIC::timer_khz = 0;
+
+bool LAPIC::Init() {
+    if (regs) return true;
+    if (!CPU::Has(CPU::FEATURE_APIC)) return false;
+
+    uint64_t base_msr = CPU::ReadMSR(IA32_APIC_BASE);
+    uint32_t base = (uint32_t)base_msr & 0xFFFFF000;
+    if (!PageTableManager::MapRange(base, base, PAGE_SIZE, PAGE_WRITE | PAGE_NO_CACHE | PAGE_GLOBAL, "lapic")) return false;
+    CPU::WriteMSR(IA32_APIC_BASE, base_msr | APIC_BASE_ENABLE);
+    regs = (volatile uint32_t*)base;
+
+    // LINT0 keeps whatever the firmware set up (virtual wire to the PIC)
+    Write(LAPIC_SVR, SVR_ENABLE | LAPIC_SPURIOUS_VECTOR);
+    Write(LAPIC_TPR, 0);
+
+    // Count the timer down for a known interval
+    Write(LAPIC_TIMER_DIV, TIMER_DIV_16);
+    Write(LAPIC_LVT_TIMER, LVT_MASKED);
+    Write(LAPIC_TIMER_INIT, 0xFFFFFFFF);
+    Clock::DelayUs(CALIBRATE_US);
+    uint32_t elapsed = 0xFFFFFFFF - Read(LAPIC_TIMER_COUNT);
+    Write(LAPIC_TIMER_INIT, 0);
+    timer_khz = elapsed / (CALIBRATE_US / 1000);
+    return true;
+}
+
+void LAPIC::InitCpu() {
+    Write(LAPIC_SVR, SVR_ENABLE | LAPIC_SPURIOUS_VECTOR);
+    Write(LAPIC_TPR, 0);
+    Write(LAPIC_LVT_ERROR, LVT_MASKED);
+    Write(LAPIC_LVT_TIMER, LVT_MASKED);
+    Write(LAPIC_TIMER_DIV, TIMER_DIV_16);
+}
+
+uint8_t LAPIC::Id() {
+    return regs ? Read(LAPIC_ID) >> 24 : 0;
+}
+
+void LAPIC::EOI() {
+    Write(LAPIC_EOI, 0);
+}
+
+bool LAPIC::Pending(uint8_t vector) {
+    return (Read(LAPIC_IRR + (vector / 32) * 0x10) >> (vector % 32)) & 1;
+}
+
+void LAPIC::MaskLegacy() {
+    Write(LAPIC_LVT_LINT0, LVT_MASKED);
+}
+
+void LAPIC::SendICR(uint8_t apic_id, uint32_t command) {
+    while (Read(LAPIC_ICR_LO) & ICR_PENDING) asm volatile("pause");
+    Write(LAPIC_ICR_HI, (uint32_t)apic_id << 24);
+    Write(LAPIC_ICR_LO, command); // Writing the low half sends it
+}
+
+void LAPIC::SendIPI(uint8_t apic_id, uint8_t vector) {
+    SendICR(apic_id, ICR_ASSERT | ICR_FIXED | vector);
+}
+
+void LAPIC::SendInit(uint8_t apic_id) {
+    SendICR(apic_id, ICR_ASSERT | ICR_INIT);
+}
+
+void LAPIC::SendStartup(uint8_t apic_id, uint8_t vector) {
+    SendICR(apic_id, ICR_ASSERT | ICR_STARTUP | vector);
+}
+
+void LAPIC::BroadcastInit() {
+    SendICR(0, ICR_ALL_BUT_SELF | ICR_ASSERT | ICR_INIT);
+}
+
+void LAPIC::BroadcastStartup(uint8_t vector) {
+    SendICR(0, ICR_ALL_BUT_SELF | ICR_ASSERT | ICR_STARTUP | vector);
+}
+
+void LAPIC::StartTimer(uint32_t hz) {
+    uint32_t count = timer_khz * 1000 / hz;
+    if (!count) count = 1;
+    Write(LAPIC_TIMER_DIV, TIMER_DIV_16);
+    Write(LAPIC_LVT_TIMER, TIMER_PERIODIC | LAPIC_TIMER_VECTOR);
+    Write(LAPIC_TIMER_INIT, count);
+}
+
+void LAPIC::StopTimer() {
+    Write(LAPIC_LVT_TIMER, LVT_MASKED);
+    Write(LAPIC_TIMER_INIT, 0);
+}
@@ -0,0 +1,46 @@
+#ifndef LAPIC_H
+#define LAPIC_H
+#include <stdint.h>
+
+// Local APIC: every CPU's own interrupt controller, memory-mapped at the
+// same physical address on each. Used for inter-processor interrupts
+// (AP startup, rescheduling) and each CPU's preemption timer. With an I/O
+// APIC, device IRQs arrive here too and are acknowledged with EOI().
+
+#define LAPIC_TIMER_VECTOR    0x40 // Preemption tick on the APs
+#define LAPIC_RESCHED_VECTOR  0x41 // "Look at your run queue"
+#define LAPIC_SPURIOUS_VECTOR 0xFF // Needs no EOI
+
+class LAPIC {
+public:
+    static bool Init();     // Boot CPU: map and enable, calibrate the timer (once). false = no APIC
+    static void InitCpu();  // Each AP: enable its own
+    static bool Present() { return regs != 0; }
+
+    static uint8_t Id();
+    static void EOI();
+    static bool Pending(uint8_t vector); // Accepted by this CPU but not yet serviced
+    static void MaskLegacy();            // Stop taking 8259 interrupts (LINT0 virtual wire)
+
+    static void SendIPI(uint8_t apic_id, uint8_t vector);
+    // AP startup: INIT, then the SIPIs that start the CPU in real mode at
+    // page 'vector' (address = vector << 12). To one CPU, or to every CPU
+    // but this one when the MADT doesn't say which exist.
+    static void SendInit(uint8_t apic_id);
+    static void SendStartup(uint8_t apic_id, uint8_t vector);
+    static void BroadcastInit();
+    static void BroadcastStartup(uint8_t vector);
+
+    // Periodic LAPIC_TIMER_VECTOR at 'hz' on the calling CPU
+    static void StartTimer(uint32_t hz);
+    static void StopTimer();
+
+private:
+    static uint32_t Read(uint32_t reg) { return regs[reg / 4]; }
+    static void Write(uint32_t reg, uint32_t value) { regs[reg / 4] = value; }
+    static void SendICR(uint8_t apic_id, uint32_t command);
+
+    static volatile uint32_t* regs;
+    static uint32_t timer_khz; // Timer input clock (bus clock / 16)
+};
+#endif
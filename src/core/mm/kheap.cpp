@@ -1,36 +1,360 @@
 #include "kheap.h"
+#include "../../utils/spinlock.h"
+
+// Segregated-Fit Allocator with Boundary Tags
+//
+// Every block starts with a 4-byte header: [size | PREV_INUSE | INUSE].
+// Free blocks also carry next/prev bin links and a footer (size) in their
+// last word, so kfree() can find and merge both neighbours in O(1).
+//
+// Bins:
+//   0..63  - exact small classes, one per 8-byte step (block size < 512).
+//            Shell tokens, FileEntry arrays and Ext4 block buffers land here,
+//            so the common case is a single list pop.
+//   64..   - power-of-two classes for larger blocks (first fit in the bin).
+// A bitmap of non-empty bins lets us jump straight to the next usable bin.
+
+#define HEAP_ALIGN      8
+#define HDR_SIZE        4
+#define MIN_BLOCK       16              // header + next + prev + footer
+#define SMALL_LIMIT     512
+#define NUM_SMALL_BINS  (SMALL_LIMIT / HEAP_ALIGN)
+#define NUM_BINS        (NUM_SMALL_BINS + 23)   // 2^9 .. 2^31
+
+#define FLAG_INUSE      1
+#define FLAG_PREV_INUSE 2
+#define SIZE_MASK       (~(uint32_t)7)
+
+struct FreeBlock {
+    uint32_t header;
+    FreeBlock* next;
+    FreeBlock* prev;
+};
 
-// Simple Bump Allocator (Fast & Simple for bootstrapping)
 static uint32_t heap_start = 0;
-static uint32_t heap_curr = 0;
 static uint32_t heap_end = 0;
+static Spinlock heap_lock;
+
+static FreeBlock* bins[NUM_BINS];
+static uint32_t bin_map[(NUM_BINS + 31) / 32];
+
+// --- Accounting ---
+static uint32_t used_bytes = 0;
+static uint32_t peak_bytes = 0;
+static uint32_t alloc_count = 0;
+static uint32_t free_count = 0;
+static uint32_t live_per_class[NUM_BINS];
+
+static bool profiling = false;
+static KHeapSite sites[KHEAP_MAX_SITES]; // Samples past a full table are dropped
+
+// --- Block Helpers ---
+static inline uint32_t BlockSize(uint32_t* hdr) { return *hdr & SIZE_MASK; }
+static inline uint32_t* NextHeader(uint32_t* hdr) { return (uint32_t*)((uint8_t*)hdr + BlockSize(hdr)); }
+static inline uint32_t* FooterOf(uint32_t* hdr) { return (uint32_t*)((uint8_t*)hdr + BlockSize(hdr) - 4); }
+
+static inline int Log2(uint32_t v) {
+    int r;
+    asm("bsr %1, %0" : "=r"(r) : "rm"(v));
+    return r;
+}
+
+static inline int LowestBit(uint32_t v) {
+    int r;
+    asm("bsf %1, %0" : "=r"(r) : "rm"(v));
+    return r;
+}
+
+static inline int BinIndex(uint32_t size) {
+    if (size < SMALL_LIMIT) return size / HEAP_ALIGN;
+    return NUM_SMALL_BINS + (Log2(size) - 9);
+}
+
+// --- Bin Management ---
+static void BinInsert(FreeBlock* b) {
+    int idx = BinIndex(BlockSize(&b->header));
+    b->prev = 0;
+    b->next = bins[idx];
+    if (bins[idx]) bins[idx]->prev = b;
+    bins[idx] = b;
+    bin_map[idx / 32] |= (1u << (idx % 32));
+}
+
+static void BinRemove(FreeBlock* b) {
+    int idx = BinIndex(BlockSize(&b->header));
+    if (b->prev) b->prev->next = b->next;
+    else bins[idx] = b->next;
+    if (b->next) b->next->prev = b->prev;
+    if (!bins[idx]) bin_map[idx / 32] &= ~(1u << (idx % 32));
+}
+
+// First non-empty bin with index >= idx, or -1.
+static int NextNonEmptyBin(int idx) {
+    int word = idx / 32;
+    uint32_t bits = bin_map[word] & (~0u << (idx % 32));
+    while (true) {
+        if (bits) return word * 32 + LowestBit(bits);
+        if (++word >= (int)(sizeof(bin_map) / 4)) return -1;
+        bits = bin_map[word];
+    }
+}
+
+// Mark a free block and publish it (footer + successor's PREV_INUSE).
+static void MakeFree(uint32_t* hdr, uint32_t size, uint32_t prev_flag) {
+    *hdr = size | prev_flag;
+    *FooterOf(hdr) = size;
+    uint32_t* next = NextHeader(hdr);
+    *next &= ~FLAG_PREV_INUSE;
+    BinInsert((FreeBlock*)hdr);
+}
+
+static void RecordSite(void* caller, uint32_t bytes) {
+    // Open addressing on the return address
+    uint32_t h = ((uint32_t)caller >> 2) % KHEAP_MAX_SITES;
+    for (int probe = 0; probe < KHEAP_MAX_SITES; probe++) {
+        KHeapSite* s = &sites[(h + probe) % KHEAP_MAX_SITES];
+        if (s->caller != caller && s->caller != 0) continue;
+        s->caller = caller;
+        s->allocs++;
+        s->bytes += bytes;
+        return;
+    }
+}
+
+static void AccountAlloc(uint32_t* hdr) {
+    uint32_t size = BlockSize(hdr);
+    used_bytes += size;
+    if (used_bytes > peak_bytes) peak_bytes = used_bytes;
+    alloc_count++;
+    live_per_class[BinIndex(size)]++;
+}
+
+static void AccountFree(uint32_t* hdr) {
+    uint32_t size = BlockSize(hdr);
+    used_bytes -= size;
+    free_count++;
+    live_per_class[BinIndex(size)]--;
+}
 
 void kheap_init(uint32_t start, uint32_t size) {
-    heap_start = start;
-    heap_curr = start;
-    heap_end = start + size;
+    for (int i = 0; i < NUM_BINS; i++) bins[i] = 0;
+    for (uint32_t i = 0; i < sizeof(bin_map) / 4; i++) bin_map[i] = 0;
+
+    // Payloads must be 8-aligned, so headers sit at 8n+4.
+    uint32_t first = ((start + HDR_SIZE + HEAP_ALIGN - 1) & ~(HEAP_ALIGN - 1)) - HDR_SIZE;
+    uint32_t last = ((start + size) & ~(HEAP_ALIGN - 1)) - HDR_SIZE; // Epilogue header
+    heap_start = first;
+    heap_end = last;
+
+    // Epilogue: zero-sized, permanently in use. Stops forward coalescing.
+    *(uint32_t*)last = 0 | FLAG_INUSE;
+
+    uint32_t span = last - first;
+    if (span >= MIN_BLOCK) {
+        // Nothing lives before the first block, so claim it as "in use".
+        MakeFree((uint32_t*)first, span, FLAG_PREV_INUSE);
+    }
+}
+
+// Carve a block for 'size' payload bytes (no accounting). Returns its header.
+static uint32_t* TakeBlock(size_t size) {
+    if (heap_end == 0) return 0;
+
+    uint32_t need = (size + HDR_SIZE + HEAP_ALIGN - 1) & ~(HEAP_ALIGN - 1);
+    if (need < MIN_BLOCK) need = MIN_BLOCK;
+    if (need < size) return 0; // Overflow
+
+    // Find a fitting free block
+    FreeBlock* b = 0;
+    int idx = BinIndex(need);
+
+    if (idx < NUM_SMALL_BINS && bins[idx]) {
+        b = bins[idx]; // Exact fit, O(1)
+    } else {
+        // Large class: first fit inside the request's own bin
+        if (idx >= NUM_SMALL_BINS) {
+            for (FreeBlock* c = bins[idx]; c; c = c->next) {
+                if (BlockSize(&c->header) >= need) { b = c; break; }
+            }
+            idx++;
+        }
+        // Otherwise any block in a higher bin is big enough
+        if (!b) {
+            int next = (idx < NUM_BINS) ? NextNonEmptyBin(idx) : -1;
+            if (next < 0) return 0; // Out of Memory
+            b = bins[next];
+        }
+    }
+
+    BinRemove(b);
+
+    uint32_t* hdr = &b->header;
+    uint32_t bsize = BlockSize(hdr);
+    uint32_t prev_flag = *hdr & FLAG_PREV_INUSE;
+
+    // Split off the tail if it can hold a block on its own
+    if (bsize - need >= MIN_BLOCK) {
+        *hdr = need | prev_flag | FLAG_INUSE;
+        MakeFree(NextHeader(hdr), bsize - need, FLAG_PREV_INUSE);
+    } else {
+        *hdr = bsize | prev_flag | FLAG_INUSE;
+        *NextHeader(hdr) |= FLAG_PREV_INUSE;
+    }
+
+    return hdr;
+}
+
+static void* Allocate(size_t size, void* caller) {
+    SpinlockGuard guard(heap_lock);
+    uint32_t* hdr = TakeBlock(size);
+    if (!hdr) return 0;
+
+    AccountAlloc(hdr);
+    if (profiling) RecordSite(caller, size);
+    return (void*)(hdr + 1);
 }
 
 void* kmalloc(size_t size) {
-    // Align to 4 bytes
-    if (heap_curr % 4 != 0) heap_curr += (4 - (heap_curr % 4));
+    return Allocate(size, __builtin_return_address(0));
+}
+
+// Return an in-use block to the bins, merging with free neighbours.
+static void Release(uint32_t* hdr) {
+    uint32_t size = BlockSize(hdr);
+    uint32_t prev_flag = *hdr & FLAG_PREV_INUSE;
 
-    if (heap_curr + size >= heap_end) return 0; // Out of Memory
+    // Merge with next neighbour
+    uint32_t* next = NextHeader(hdr);
+    if (!(*next & FLAG_INUSE)) {
+        BinRemove((FreeBlock*)next);
+        size += BlockSize(next);
+    }
 
-    void* ret = (void*)heap_curr;
-    heap_curr += size;
-    return ret;
+    // Merge with previous neighbour (its footer sits just before us)
+    if (!prev_flag) {
+        uint32_t prev_size = *(hdr - 1);
+        hdr = (uint32_t*)((uint8_t*)hdr - prev_size);
+        BinRemove((FreeBlock*)hdr);
+        size += prev_size;
+        prev_flag = *hdr & FLAG_PREV_INUSE;
+    }
+
+    MakeFree(hdr, size, prev_flag);
 }
 
 void kfree(void* ptr) {
-    // Bump allocators cannot free individual blocks.
-    // We will replace this with a Linked List allocator later.
-    (void)ptr;
+    if (!ptr) return;
+
+    uint32_t* hdr = (uint32_t*)ptr - 1;
+    if ((uint32_t)hdr < heap_start || (uint32_t)hdr >= heap_end) return; // Not ours
+    if (!(*hdr & FLAG_INUSE)) return; // Double free
+
+    SpinlockGuard guard(heap_lock);
+
+    AccountFree(hdr);
+    Release(hdr);
+}
+
+void* kmalloc_aligned(size_t size, uint32_t align) {
+    if (align <= HEAP_ALIGN) return Allocate(size, __builtin_return_address(0));
+    SpinlockGuard guard(heap_lock);
+
+    // Over-allocate so an aligned payload with room for a free block
+    // in front of it is guaranteed to exist inside the block.
+    uint32_t* hdr = TakeBlock(size + align + MIN_BLOCK);
+    if (!hdr) return 0;
+    uint8_t* raw = (uint8_t*)(hdr + 1);
+    uint32_t addr = (uint32_t)raw;
+    if (addr & (align - 1)) {
+        addr = (addr + MIN_BLOCK + align - 1) & ~(align - 1);
+        uint32_t gap = addr - (uint32_t)raw;
+        uint32_t bsize = BlockSize(hdr);
+
+        // Give the leading gap back to the heap
+        uint32_t* aligned_hdr = (uint32_t*)addr - 1;
+        *aligned_hdr = (bsize - gap) | FLAG_PREV_INUSE | FLAG_INUSE;
+        *hdr = gap | (*hdr & FLAG_PREV_INUSE) | FLAG_INUSE;
+        Release(hdr);
+        hdr = aligned_hdr;
+    }
+
+    // Give the unused tail back as well
+    uint32_t need = (size + HDR_SIZE + HEAP_ALIGN - 1) & ~(HEAP_ALIGN - 1);
+    if (need < MIN_BLOCK) need = MIN_BLOCK;
+    uint32_t bsize = BlockSize(hdr);
+    if (bsize - need >= MIN_BLOCK) {
+        *hdr = need | (*hdr & FLAG_PREV_INUSE) | FLAG_INUSE;
+        uint32_t* tail = NextHeader(hdr);
+        *tail = (bsize - need) | FLAG_PREV_INUSE | FLAG_INUSE;
+        Release(tail);
+    }
+
+    AccountAlloc(hdr); // Only the trimmed block counts
+    if (profiling) RecordSite(__builtin_return_address(0), size);
+    return (void*)addr;
+}
+
+void kheap_stats(KHeapStats* out) {
+    SpinlockGuard guard(heap_lock);
+    out->heap_size = heap_end - heap_start;
+    out->used_bytes = used_bytes;
+    out->peak_bytes = peak_bytes;
+    out->allocs = alloc_count;
+    out->frees = free_count;
+    out->free_bytes = 0;
+    out->free_blocks = 0;
+    out->largest_free = 0;
+
+    for (int i = 0; i < NUM_BINS; i++) {
+        out->live_per_class[i] = live_per_class[i];
+        for (FreeBlock* b = bins[i]; b; b = b->next) {
+            uint32_t size = BlockSize(&b->header);
+            out->free_bytes += size;
+            out->free_blocks++;
+            if (size > out->largest_free) out->largest_free = size;
+        }
+    }
+    if (out->largest_free >= HDR_SIZE) out->largest_free -= HDR_SIZE; // Usable payload
+}
+
+uint32_t kheap_class_size(int cls) {
+    if (cls < NUM_SMALL_BINS) return cls * HEAP_ALIGN;
+    return 1u << (cls - NUM_SMALL_BINS + 9);
+}
+
+void kheap_profile(bool enable) {
+    SpinlockGuard guard(heap_lock);
+    if (enable && !profiling) {
+        for (int i = 0; i < KHEAP_MAX_SITES; i++) {
+            sites[i].caller = 0;
+            sites[i].allocs = 0;
+            sites[i].bytes = 0;
+        }
+    }
+    profiling = enable;
+}
+
+bool kheap_profiling() { return profiling; }
+
+int kheap_top_sites(KHeapSite* out, int max) {
+    SpinlockGuard guard(heap_lock);
+    // Insertion sort into the caller's buffer, largest byte count first
+    int n = 0;
+    for (int i = 0; i < KHEAP_MAX_SITES; i++) {
+        if (!sites[i].caller) continue;
+        int pos = (n < max) ? n++ : max;
+        while (pos > 0 && out[pos - 1].bytes < sites[i].bytes) {
+            if (pos < max) out[pos] = out[pos - 1];
+            pos--;
+        }
+        if (pos < max) out[pos] = sites[i];
+    }
+    return n;
 }
 
 // C++ Operator Overloads
-void* operator new(size_t size) { return kmalloc(size); }
-void* operator new[](size_t size) { return kmalloc(size); }
+void* operator new(size_t size) { return Allocate(size, __builtin_return_address(0)); }
+void* operator new[](size_t size) { return Allocate(size, __builtin_return_address(0)); }
 void operator delete(void* p) { kfree(p); }
 void operator delete(void* p, size_t size) { (void)size; kfree(p); }
 void operator delete[](void* p) { kfree(p); }
@@ -6,6 +6,41 @@
 void kheap_init(uint32_t start, uint32_t size);
 void* kmalloc(size_t size);
 void kfree(void* ptr);
+void* kmalloc_aligned(size_t size, uint32_t align); // align: power of two
+
+// --- Statistics ---
+// Byte counts are whole blocks (payload + header + padding).
+#define KHEAP_SIZE_CLASSES 87 // 64 exact classes (8-byte steps) + power-of-two classes
+
+struct KHeapStats {
+    uint32_t heap_size;
+    uint32_t used_bytes;
+    uint32_t peak_bytes;
+    uint32_t free_bytes;
+    uint32_t largest_free;  // Biggest single request that can still succeed
+    uint32_t free_blocks;
+    uint32_t allocs;
+    uint32_t frees;
+    uint32_t live_per_class[KHEAP_SIZE_CLASSES];
+};
+
+void kheap_stats(KHeapStats* out);      // O(free blocks): walks the bins
+uint32_t kheap_class_size(int cls);     // Smallest block size in a class
+
+// --- Allocation-Site Profiling (off by default) ---
+// Records the caller of kmalloc/new with allocation count and bytes
+// requested, to find code paths that churn the heap.
+#define KHEAP_MAX_SITES 64
+
+struct KHeapSite {
+    void* caller;
+    uint32_t allocs;
+    uint32_t bytes;
+};
+
+void kheap_profile(bool enable);        // Enabling clears previous samples
+bool kheap_profiling();
+int kheap_top_sites(KHeapSite* out, int max); // Sorted by bytes, returns count
 
 // Standard C++ Operators
 void* operator new(size_t size);
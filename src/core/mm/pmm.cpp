@@ -0,0 +1,145 @@
+#include "pmm.h"
+#include "../../utils/spinlock.h"
+
+#define MAX_FRAMES   (PMM_MAX_MEMORY / PMM_FRAME_SIZE)
+#define BITMAP_WORDS (MAX_FRAMES / 32)
+
+struct MultibootMmapEntry {
+    uint32_t size;      // Size of the rest of the entry (excl. this field)
+    uint64_t addr;
+    uint64_t len;
+    uint32_t type;      // 1 = Available RAM
+} __attribute__((packed));
+
+// Bit set = frame used (or not RAM at all)
+static uint32_t bitmap[BITMAP_WORDS];
+static uint32_t total_frames = 0;
+static uint32_t free_frames = 0;
+static uint32_t search_hint = 0; // Lowest word that may contain a free bit
+static uint16_t extra_refs[MAX_FRAMES]; // References beyond the allocating owner
+static Spinlock pmm_lock;
+
+static inline bool Test(uint32_t f) { return bitmap[f / 32] & (1u << (f % 32)); }
+
+static inline void SetUsed(uint32_t f) {
+    if (!Test(f)) { bitmap[f / 32] |= (1u << (f % 32)); free_frames--; }
+}
+
+static inline void SetFree(uint32_t f) {
+    if (Test(f)) {
+        bitmap[f / 32] &= ~(1u << (f % 32));
+        free_frames++;
+        if (f / 32 < search_hint) search_hint = f / 32;
+    }
+}
+
+void pmm_release(uint32_t base, uint32_t length) {
+    // Only whole frames inside the range become usable
+    uint64_t start = ((uint64_t)base + PMM_FRAME_SIZE - 1) / PMM_FRAME_SIZE;
+    uint64_t end = ((uint64_t)base + length) / PMM_FRAME_SIZE;
+    if (end > MAX_FRAMES) end = MAX_FRAMES;
+    for (uint64_t f = start; f < end; f++) SetFree((uint32_t)f);
+}
+
+void pmm_reserve(uint32_t base, uint32_t length) {
+    // Any frame touched by the range is taken
+    uint64_t start = base / PMM_FRAME_SIZE;
+    uint64_t end = ((uint64_t)base + length + PMM_FRAME_SIZE - 1) / PMM_FRAME_SIZE;
+    if (end > MAX_FRAMES) end = MAX_FRAMES;
+    for (uint64_t f = start; f < end; f++) SetUsed((uint32_t)f);
+}
+
+void pmm_init(uint32_t mmap_addr, uint32_t mmap_length, uint32_t mem_upper_kb) {
+    for (uint32_t i = 0; i < BITMAP_WORDS; i++) bitmap[i] = 0xFFFFFFFF;
+    free_frames = 0;
+    search_hint = 0;
+
+    if (mmap_addr && mmap_length) {
+        uint32_t ptr = mmap_addr;
+        while (ptr < mmap_addr + mmap_length) {
+            MultibootMmapEntry* e = (MultibootMmapEntry*)ptr;
+            if (e->type == 1 && e->addr < PMM_MAX_MEMORY) {
+                uint64_t len = e->len;
+                if (e->addr + len > PMM_MAX_MEMORY) len = PMM_MAX_MEMORY - e->addr;
+                pmm_release((uint32_t)e->addr, (uint32_t)len);
+            }
+            ptr += e->size + 4;
+        }
+    } else {
+        // No map from the bootloader: trust mem_upper (KB above 1MB)
+        pmm_release(0x100000, mem_upper_kb * 1024);
+    }
+
+    // Real-mode area (IVT, BDA, EBDA, VGA, BIOS ROM) is never handed out
+    pmm_reserve(0, 0x100000);
+
+    total_frames = free_frames;
+}
+
+uint32_t pmm_alloc_frame() {
+    SpinlockGuard guard(pmm_lock);
+    for (uint32_t w = search_hint; w < BITMAP_WORDS; w++) {
+        if (bitmap[w] == 0xFFFFFFFF) continue;
+
+        int bit;
+        asm("bsf %1, %0" : "=r"(bit) : "r"(~bitmap[w]));
+        search_hint = w;
+
+        uint32_t f = w * 32 + bit;
+        SetUsed(f);
+        return f * PMM_FRAME_SIZE;
+    }
+    search_hint = BITMAP_WORDS;
+    return 0; // Out of Memory
+}
+
+uint32_t pmm_alloc_frames(uint32_t count) {
+    if (count == 0) return 0;
+    if (count == 1) return pmm_alloc_frame();
+    SpinlockGuard guard(pmm_lock);
+
+    uint32_t run = 0;
+    for (uint32_t f = search_hint * 32; f < MAX_FRAMES; f++) {
+        // Skip fully used words quickly
+        if ((f % 32) == 0 && bitmap[f / 32] == 0xFFFFFFFF) {
+            run = 0;
+            f += 31;
+            continue;
+        }
+
+        if (Test(f)) { run = 0; continue; }
+        if (++run == count) {
+            uint32_t first = f + 1 - count;
+            for (uint32_t i = first; i <= f; i++) SetUsed(i);
+            return first * PMM_FRAME_SIZE;
+        }
+    }
+    return 0; // No contiguous run
+}
+
+void pmm_free_frame(uint32_t addr) {
+    SpinlockGuard guard(pmm_lock);
+    uint32_t f = addr / PMM_FRAME_SIZE;
+    if (f >= MAX_FRAMES) return;
+    if (extra_refs[f]) { extra_refs[f]--; return; } // Still mapped elsewhere
+    SetFree(f);
+}
+
+void pmm_free_frames(uint32_t addr, uint32_t count) {
+    for (uint32_t i = 0; i < count; i++) pmm_free_frame(addr + i * PMM_FRAME_SIZE);
+}
+
+void pmm_ref_frame(uint32_t addr) {
+    SpinlockGuard guard(pmm_lock);
+    uint32_t f = addr / PMM_FRAME_SIZE;
+    if (f < MAX_FRAMES && Test(f)) extra_refs[f]++;
+}
+
+uint32_t pmm_frame_refs(uint32_t addr) {
+    uint32_t f = addr / PMM_FRAME_SIZE;
+    if (f >= MAX_FRAMES || !Test(f)) return 0;
+    return extra_refs[f] + 1;
+}
+
+uint32_t pmm_total_frames() { return total_frames; }
+uint32_t pmm_free_count() { return free_frames; }
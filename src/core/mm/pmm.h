@@ -0,0 +1,32 @@
+#ifndef PMM_H
+#define PMM_H
+#include <stdint.h>
+
+// Physical Page-Frame Allocator (bitmap, 1 bit per 4KB frame)
+// Seeded from the multiboot memory map; callers reserve whatever the
+// kernel already occupies (image, multiboot data, modules).
+
+#define PMM_FRAME_SIZE 4096
+
+// Only RAM the kernel can reach through its identity map is handed out.
+// Must match the range PageTableManager::Init identity-maps.
+#define PMM_MAX_MEMORY 0x08000000 // 128MB
+
+void pmm_init(uint32_t mmap_addr, uint32_t mmap_length, uint32_t mem_upper_kb);
+void pmm_reserve(uint32_t base, uint32_t length);
+void pmm_release(uint32_t base, uint32_t length);
+
+// Return a physical address, or 0 if out of memory.
+uint32_t pmm_alloc_frame();
+uint32_t pmm_alloc_frames(uint32_t count); // Physically contiguous
+void pmm_free_frame(uint32_t addr);   // Drops one reference; frees on the last
+void pmm_free_frames(uint32_t addr, uint32_t count);
+
+// Shared frames (copy-on-write): each extra mapping takes a reference,
+// and pmm_free_frame() only releases the frame once all are dropped.
+void pmm_ref_frame(uint32_t addr);
+uint32_t pmm_frame_refs(uint32_t addr); // 0 = free
+
+uint32_t pmm_total_frames();
+uint32_t pmm_free_count();
+#endif
@@ -0,0 +1,195 @@
+#include "slab.h"
+#include "kheap.h"
+#include "../../utils/spinlock.h"
+
+// Slab Layout (slab_size bytes, aligned to slab_size):
+//   [Slab header][pad to align][obj 0 | link][obj 1 | link] ...
+// The free-list link lives *after* each object rather than inside it,
+// so a constructed object keeps its state while it sits in the cache.
+
+#define SLAB_PAGE_SIZE   4096
+#define SLAB_MIN_OBJECTS 4
+#define SLAB_KEEP_EMPTY  1   // Empty slabs kept around before returning to kheap
+
+struct Slab {
+    SlabCache* cache;
+    Slab* next;
+    Slab* prev;
+    uint8_t* free_list;
+    uint32_t inuse;
+};
+
+struct SlabCache {
+    Spinlock lock;          // Its slabs and counters
+    const char* name;
+    uint32_t object_size;
+    uint32_t link_offset;
+    uint32_t stride;
+    uint32_t first_offset;
+    uint32_t slab_size;
+    uint32_t per_slab;
+    void (*ctor)(void*);
+
+    Slab* partial;
+    Slab* full;
+    Slab* empty;
+    uint32_t empty_count;
+
+    uint32_t slabs;
+    uint32_t active;
+    uint32_t allocs;
+    uint32_t frees;
+
+    SlabCache* next;
+};
+
+static SlabCache* cache_list = 0;
+static Spinlock list_lock; // cache_list
+
+static inline uint32_t AlignUp(uint32_t v, uint32_t a) { return (v + a - 1) & ~(a - 1); }
+static inline uint8_t** LinkOf(SlabCache* c, uint8_t* obj) { return (uint8_t**)(obj + c->link_offset); }
+
+// --- List Helpers ---
+static void ListPush(Slab** head, Slab* s) {
+    s->prev = 0;
+    s->next = *head;
+    if (*head) (*head)->prev = s;
+    *head = s;
+}
+
+static void ListRemove(Slab** head, Slab* s) {
+    if (s->prev) s->prev->next = s->next;
+    else *head = s->next;
+    if (s->next) s->next->prev = s->prev;
+}
+
+SlabCache* slab_cache_create(const char* name, size_t size, size_t align, void (*ctor)(void*)) {
+    if (align < 4) align = 4;
+    if (align & (align - 1)) return 0; // Must be a power of two
+
+    SlabCache* c = (SlabCache*)kmalloc(sizeof(SlabCache));
+    if (!c) return 0;
+
+    c->name = name;
+    c->object_size = size;
+    c->link_offset = AlignUp(size, 4);
+    c->stride = AlignUp(c->link_offset + sizeof(uint8_t*), align);
+    c->first_offset = AlignUp(sizeof(Slab), align);
+
+    // Smallest power-of-two slab that holds a handful of objects
+    c->slab_size = SLAB_PAGE_SIZE;
+    while ((c->slab_size - c->first_offset) / c->stride < SLAB_MIN_OBJECTS)
+        c->slab_size <<= 1;
+    c->per_slab = (c->slab_size - c->first_offset) / c->stride;
+
+    c->ctor = ctor;
+    c->partial = c->full = c->empty = 0;
+    c->empty_count = 0;
+    c->slabs = c->active = c->allocs = c->frees = 0;
+
+    c->lock = Spinlock();
+
+    SpinlockGuard guard(list_lock);
+    c->next = cache_list;
+    cache_list = c;
+    return c;
+}
+
+static Slab* Grow(SlabCache* c) {
+    Slab* s = (Slab*)kmalloc_aligned(c->slab_size, c->slab_size);
+    if (!s) return 0;
+
+    s->cache = c;
+    s->inuse = 0;
+    s->free_list = 0;
+
+    // Thread the free list back-to-front so allocation walks upwards
+    uint8_t* base = (uint8_t*)s + c->first_offset;
+    for (int i = c->per_slab - 1; i >= 0; i--) {
+        uint8_t* obj = base + i * c->stride;
+        if (c->ctor) c->ctor(obj);
+        *LinkOf(c, obj) = s->free_list;
+        s->free_list = obj;
+    }
+
+    c->slabs++;
+    c->empty_count++;
+    ListPush(&c->empty, s);
+    return s;
+}
+
+void* slab_alloc(SlabCache* c) {
+    if (!c) return 0;
+    SpinlockGuard guard(c->lock);
+
+    Slab* s = c->partial;
+    if (!s) {
+        s = c->empty ? c->empty : Grow(c);
+        if (!s) return 0; // Out of Memory
+        ListRemove(&c->empty, s);
+        c->empty_count--;
+        ListPush(&c->partial, s);
+    }
+
+    uint8_t* obj = s->free_list;
+    s->free_list = *LinkOf(c, obj);
+    s->inuse++;
+
+    if (s->inuse == c->per_slab) {
+        ListRemove(&c->partial, s);
+        ListPush(&c->full, s);
+    }
+
+    c->active++;
+    c->allocs++;
+    return obj;
+}
+
+void slab_free(SlabCache* c, void* ptr) {
+    if (!c || !ptr) return;
+
+    uint8_t* obj = (uint8_t*)ptr;
+    Slab* s = (Slab*)((uint32_t)obj & ~(c->slab_size - 1));
+    if (s->cache != c) return; // Wrong cache
+    SpinlockGuard guard(c->lock);
+
+    bool was_full = (s->inuse == c->per_slab);
+    *LinkOf(c, obj) = s->free_list;
+    s->free_list = obj;
+    s->inuse--;
+
+    if (was_full) {
+        ListRemove(&c->full, s);
+        ListPush(&c->partial, s);
+    }
+
+    if (s->inuse == 0) {
+        ListRemove(&c->partial, s);
+        if (c->empty_count >= SLAB_KEEP_EMPTY) {
+            kfree(s);
+            c->slabs--;
+        } else {
+            ListPush(&c->empty, s);
+            c->empty_count++;
+        }
+    }
+
+    c->active--;
+    c->frees++;
+}
+
+void slab_cache_stats(SlabCache* c, SlabStats* out) {
+    out->name = c->name;
+    out->object_size = c->object_size;
+    out->stride = c->stride;
+    out->objects_per_slab = c->per_slab;
+    out->slabs = c->slabs;
+    out->active_objects = c->active;
+    out->total_objects = c->slabs * c->per_slab;
+    out->allocs = c->allocs;
+    out->frees = c->frees;
+}
+
+SlabCache* slab_cache_next(SlabCache* prev) {
+    return prev ? prev->next : cache_list;
+}
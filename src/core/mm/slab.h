@@ -0,0 +1,34 @@
+#ifndef SLAB_H
+#define SLAB_H
+#include <stddef.h>
+#include <stdint.h>
+
+// Object caches for fixed-size kernel objects, layered on kheap.
+// Objects are carved from power-of-two sized, self-aligned slabs, so
+// alloc/free are O(1) and the owning slab is found with a mask.
+
+#define SLAB_CACHE_LINE 64
+
+struct SlabCache;
+
+struct SlabStats {
+    const char* name;
+    uint32_t object_size;
+    uint32_t stride;            // Object size incl. padding/link
+    uint32_t objects_per_slab;
+    uint32_t slabs;
+    uint32_t active_objects;
+    uint32_t total_objects;
+    uint32_t allocs;
+    uint32_t frees;
+};
+
+// ctor (optional) runs once per object when its slab is created.
+// Objects must be handed back to slab_free() in constructed state.
+SlabCache* slab_cache_create(const char* name, size_t size, size_t align, void (*ctor)(void*));
+void* slab_alloc(SlabCache* cache);
+void slab_free(SlabCache* cache, void* obj);
+
+void slab_cache_stats(SlabCache* cache, SlabStats* out);
+SlabCache* slab_cache_next(SlabCache* prev); // Iterate all caches (prev = 0 for first)
+#endif
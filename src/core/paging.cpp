@@ -1,75 +1,646 @@
 #include "paging.h"
+#include "cpu.h"
+#include "smp.h"
+#include "../utils/spinlock.h"
+#include "mm/pmm.h"
 #include "mm/kheap.h"
 
-uint32_t* page_directory = 0;
+#define CR0_WP  0x00010000 // Honour read-only pages in ring 0 too (needed for COW)
+#define CR0_PG  0x80000000
+#define CR4_PSE 0x010
+#define CR4_PGE 0x080
 
-extern "C" void MapMemory(uint32_t virt, uint32_t phys) {
-    // 1. Calculate Indices
-    uint32_t pd_index = virt >> 22;
-    uint32_t pt_index = (virt >> 12) & 0x03FF;
-
-    // 2. Get Directory
-    // page_directory is static member but accessible here if we just use the global one or class one?
-    // The user snippet uses `extern uint32_t* page_directory` inside the function but we have it global in this file.
-    // Let's use the file global `page_directory`.
-    
-    // 3. Check if Page Table exists
-    if ((page_directory[pd_index] & 1) == 0) {
-        // Allocate new table
-        uint32_t* new_pt = (uint32_t*)kmalloc(4096);
+#define ENTRY_ATTRS (PAGE_WRITE | PAGE_USER | PAGE_WRITE_THROUGH | PAGE_NO_CACHE | PAGE_GLOBAL)
+
+uint32_t* page_directory = 0; // Kernel directory (master copy of the kernel slots)
+
+static bool use_large_pages = false;
+static bool use_global_pages = false;
+
+// --- Deferred TLB Invalidation ---
+// Per CPU: invlpg only reaches the TLB of the CPU that runs it
+struct TlbBatch {
+    uint32_t pending[TLB_FLUSH_THRESHOLD];
+    int count;
+    bool full;   // Too many pages: flush everything
+    bool global; // A global entry changed: CR3 reload is not enough
+    int depth;
+};
+static TlbBatch batches[MAX_CPUS];
+
+static inline TlbBatch* Batch() { return &batches[SMP::CpuIndex()]; }
+
+// Kernel directory and the region table (user slots belong to the one
+// thread running in that space)
+static Spinlock vm_lock;
+
+// --- Region Bookkeeping ---
+static VmRegion regions[MAX_VM_REGIONS];
+static int region_count = 0;
+
+// --- Address Spaces ---
+static AddressSpace kernel_space;
+static AddressSpace* current_spaces[MAX_CPUS]; // 0 = kernel_space
+static uint32_t kernel_generation = 0; // Bumped whenever a kernel slot changes
+static bool kernel_dirty = false;
+
+static inline AddressSpace* Current() {
+    AddressSpace* space = current_spaces[SMP::CpuIndex()];
+    return space ? space : &kernel_space;
+}
+
+static inline bool IsUserSlot(uint32_t pd_index) {
+    return pd_index == (USER_IMAGE_BASE >> 22) ||
+           (pd_index >= (USER_HEAP_BASE >> 22) && pd_index < (USER_STACK_TOP >> 22));
+}
+
+// Directory that owns a slot: user slots belong to the active address
+// space, kernel slots are edited in the kernel directory and copied out.
+static inline uint32_t* DirectoryFor(uint32_t pd_index) {
+    if (IsUserSlot(pd_index)) return Current()->directory;
+    kernel_dirty = true;
+    return page_directory;
+}
+
+static void SyncKernelSlots(AddressSpace* space) {
+    for (uint32_t i = 0; i < 1024; i++) {
+        if (!IsUserSlot(i)) space->directory[i] = page_directory[i];
+    }
+    space->kernel_generation = kernel_generation;
+}
+
+static void ReloadCR3() {
+    uint32_t cr3;
+    asm volatile("mov %%cr3, %0" : "=r"(cr3));
+    asm volatile("mov %0, %%cr3" : : "r"(cr3) : "memory");
+}
+
+// Remember that 'virt' must be invalidated. Entries that were not present
+// are never cached by the TLB, so filling a hole costs nothing.
+static void QueueInvalidate(uint32_t virt, uint32_t old_entry) {
+    if (!(old_entry & PAGE_PRESENT)) return;
+    TlbBatch* b = Batch();
+    if (old_entry & PAGE_GLOBAL) b->global = true;
+    if (b->full) return;
+    if (b->count == TLB_FLUSH_THRESHOLD) { b->full = true; return; }
+    b->pending[b->count++] = virt;
+}
+
+static void Commit() {
+    TlbBatch* b = Batch();
+    if (b->depth > 0) return;
+
+    // Publish kernel directory changes before the TLB work below. Other
+    // CPUs pick new kernel slots up on their next address-space switch;
+    // kernel mappings are only added, and only while booting.
+    if (kernel_dirty) {
+        kernel_dirty = false;
+        kernel_generation++;
+        AddressSpace* space = Current();
+        if (space != &kernel_space) SyncKernelSlots(space);
+    }
+
+    if (b->full) {
+        if (b->global) PageTableManager::FlushTLB();
+        else ReloadCR3();
+    } else {
+        for (int i = 0; i < b->count; i++)
+            asm volatile("invlpg (%0)" : : "r" (b->pending[i]) : "memory");
+    }
+
+    b->count = 0;
+    b->full = false;
+    b->global = false;
+}
+
+static uint32_t SanitizeFlags(uint32_t flags) {
+    if (!use_global_pages) flags &= ~PAGE_GLOBAL;
+    return (flags & ENTRY_ATTRS) | PAGE_PRESENT;
+}
+
+// Page table for a directory slot, creating it (or splitting a 4MB page
+// into 1024 equivalent 4KB entries) when needed. Returns 0 if out of memory.
+static uint32_t* GetTable(uint32_t pd_index) {
+    uint32_t* dir = DirectoryFor(pd_index);
+    uint32_t pde = dir[pd_index];
+
+    if ((pde & PAGE_PRESENT) && !(pde & PAGE_LARGE))
+        return (uint32_t*)(pde & 0xFFFFF000);
+
+    // Allocate new table (one physical frame, already page-aligned)
+    uint32_t* new_pt = (uint32_t*)pmm_alloc_frame();
+    if (!new_pt) return 0; // Out of Memory
+
+    if (pde & PAGE_PRESENT) {
+        // Split: keep the large page's translation, now at 4KB granularity
+        uint32_t base = pde & 0xFFC00000;
+        for(int i=0; i<1024; i++) new_pt[i] = (base + i * PAGE_SIZE) | (pde & ENTRY_ATTRS) | PAGE_PRESENT;
+        dir[pd_index] = ((uint32_t)new_pt) | (pde & (PAGE_WRITE | PAGE_USER)) | PAGE_PRESENT;
+    } else {
         for(int i=0; i<1024; i++) new_pt[i] = 0x2; // Not Present
-        
-        page_directory[pd_index] = ((uint32_t)new_pt) | 7; // Present, RW, User
+        dir[pd_index] = ((uint32_t)new_pt) | PAGE_WRITE | PAGE_PRESENT; // Callers add PAGE_USER
     }
+    return new_pt;
+}
 
-    // 4. Get Table
-    uint32_t* pt = (uint32_t*)(page_directory[pd_index] & 0xFFFFF000);
-    
-    // 5. Map the Page
-    pt[pt_index] = (phys & 0xFFFFF000) | 7; // Present, RW, User
-    
-    // 6. Flush TLB (Tell CPU to refresh cache)
-    asm volatile("invlpg (%0)" : : "r" (virt) : "memory");
+static inline bool CoversLargePage(uint32_t virt, uint32_t end) {
+    return (virt & (LARGE_PAGE_SIZE - 1)) == 0 && end - virt >= LARGE_PAGE_SIZE;
+}
+
+// A global entry would outlive the CR3 switch to another address space
+static inline uint32_t SlotFlags(uint32_t pd_index, uint32_t flags) {
+    return IsUserSlot(pd_index) ? (flags & ~PAGE_GLOBAL) : flags;
+}
+
+// --- Page-Level Workers (no region bookkeeping, invalidation queued) ---
+static bool MapPages(uint32_t virt, uint32_t phys, uint32_t end, uint32_t map_flags) {
+    while (virt < end) {
+        uint32_t pd_index = virt >> 22;
+        uint32_t flags = SlotFlags(pd_index, map_flags);
+        uint32_t* dir = DirectoryFor(pd_index);
+        uint32_t pde = dir[pd_index];
+        bool has_table = (pde & PAGE_PRESENT) && !(pde & PAGE_LARGE);
+
+        // Whole, aligned 4MB chunk not already split into a table: one directory entry
+        if (use_large_pages && !has_table && CoversLargePage(virt, end) && (phys & (LARGE_PAGE_SIZE - 1)) == 0) {
+            dir[pd_index] = phys | flags | PAGE_LARGE;
+            QueueInvalidate(virt, pde);
+            virt += LARGE_PAGE_SIZE;
+            phys += LARGE_PAGE_SIZE;
+            continue;
+        }
+
+        uint32_t* pt = GetTable(pd_index);
+        if (!pt) return false;
+        dir[pd_index] |= flags & (PAGE_USER | PAGE_WRITE); // Directory must allow it too
+
+        uint32_t pt_index = (virt >> 12) & 0x03FF;
+        uint32_t old = pt[pt_index];
+        pt[pt_index] = (phys & 0xFFFFF000) | flags;
+        QueueInvalidate(virt, old);
+        virt += PAGE_SIZE;
+        phys += PAGE_SIZE;
+    }
+    return true;
+}
+
+// new_flags == 0 unmaps, otherwise rewrites the attributes of present pages.
+static void UpdatePages(uint32_t virt, uint32_t end, uint32_t update_flags) {
+    while (virt < end) {
+        uint32_t pd_index = virt >> 22;
+        uint32_t new_flags = SlotFlags(pd_index, update_flags);
+        uint32_t* dir = DirectoryFor(pd_index);
+        uint32_t pde = dir[pd_index];
+
+        if (!(pde & PAGE_PRESENT)) {
+            virt = (virt & ~(LARGE_PAGE_SIZE - 1)) + LARGE_PAGE_SIZE; // Nothing mapped here
+            continue;
+        }
+
+        if (pde & PAGE_LARGE) {
+            if (CoversLargePage(virt, end)) {
+                dir[pd_index] = new_flags ? ((pde & 0xFFC00000) | new_flags | PAGE_LARGE) : 0x2;
+                QueueInvalidate(virt, pde);
+                virt += LARGE_PAGE_SIZE;
+                continue;
+            }
+            if (!GetTable(pd_index)) return; // Split, then handle 4KB pieces
+        }
+
+        uint32_t* pt = (uint32_t*)(dir[pd_index] & 0xFFFFF000);
+        if (new_flags) dir[pd_index] |= new_flags & (PAGE_USER | PAGE_WRITE);
+
+        uint32_t pt_index = (virt >> 12) & 0x03FF;
+        uint32_t old = pt[pt_index];
+        if (old & PAGE_PRESENT) {
+            uint32_t flags = new_flags;
+            if ((old & PAGE_COW) && flags) flags = (flags & ~PAGE_WRITE) | PAGE_COW; // Still shared, whatever is asked
+            pt[pt_index] = flags ? ((old & 0xFFFFF000) | flags) : 0x2;
+            QueueInvalidate(virt, old);
+        }
+        virt += PAGE_SIZE;
+    }
+}
+
+// Unmap 4KB pages in [virt, end) of the active user space and hand their
+// frames back to the PMM.
+static void ReleasePages(uint32_t virt, uint32_t end) {
+    while (virt < end) {
+        uint32_t pde = Current()->directory[virt >> 22];
+        if (!(pde & PAGE_PRESENT) || (pde & PAGE_LARGE)) {
+            virt = (virt & ~(LARGE_PAGE_SIZE - 1)) + LARGE_PAGE_SIZE;
+            continue;
+        }
+
+        uint32_t* pt = (uint32_t*)(pde & 0xFFFFF000);
+        uint32_t pt_index = (virt >> 12) & 0x03FF;
+        uint32_t old = pt[pt_index];
+        if (old & PAGE_PRESENT) {
+            pt[pt_index] = 0x2;
+            QueueInvalidate(virt, old);
+            pmm_free_frame(old & 0xFFFFF000);
+        }
+        virt += PAGE_SIZE;
+    }
+}
+
+static inline void ZeroFrame(uint32_t frame) {
+    uint32_t dst = frame, count = PAGE_SIZE / 4;
+    asm volatile("cld; rep stosl" : "+D"(dst), "+c"(count) : "a"(0) : "memory");
+}
+
+static inline void CopyFrame(uint32_t dst, uint32_t src) {
+    uint32_t count = PAGE_SIZE / 4;
+    asm volatile("cld; rep movsl" : "+D"(dst), "+S"(src), "+c"(count) : : "memory");
+}
+
+// The part of a file-backed region's data that falls in 'page' (the frame
+// is already zeroed)
+static void FillFromData(uint32_t frame, uint32_t page, const DemandRegion* r) {
+    uint32_t lo = page > r->data_start ? page : r->data_start;
+    uint32_t hi = r->data_start + r->data_size;
+    if (hi > page + PAGE_SIZE) hi = page + PAGE_SIZE;
+    if (lo >= hi) return;
+
+    uint32_t dst = frame + (lo - page), count = hi - lo;
+    const uint8_t* src = r->data + (lo - r->data_start);
+    asm volatile("cld; rep movsb" : "+D"(dst), "+S"(src), "+c"(count) : : "memory");
+}
+
+// Write fault on a copy-on-write page: take a private copy, or just the
+// write bit back if every other sharer has already copied it.
+static bool BreakCow(uint32_t addr) {
+    uint32_t pde = Current()->directory[addr >> 22];
+    if (!(pde & PAGE_PRESENT) || (pde & PAGE_LARGE)) return false;
+
+    uint32_t* pt = (uint32_t*)(pde & 0xFFFFF000);
+    uint32_t pt_index = (addr >> 12) & 0x03FF;
+    uint32_t old = pt[pt_index];
+    if (!(old & PAGE_COW)) return false;
+
+    uint32_t frame = old & 0xFFFFF000;
+    uint32_t attrs = (old & ENTRY_ATTRS) | PAGE_WRITE | PAGE_PRESENT;
+
+    if (pmm_frame_refs(frame) > 1) {
+        uint32_t copy = pmm_alloc_frame();
+        if (!copy) return false; // Out of Memory
+        CopyFrame(copy, frame);
+        pmm_free_frame(frame); // Drop our share
+        frame = copy;
+    }
+
+    pt[pt_index] = frame | attrs;
+    QueueInvalidate(addr & 0xFFFFF000, old);
+    Commit();
+    return true;
+}
+
+// --- Region Table ---
+static void AddRegion(uint32_t start, uint32_t size, uint32_t phys, uint32_t flags, const char* name) {
+    if (region_count >= MAX_VM_REGIONS) return; // Bookkeeping only; mapping still stands
+    VmRegion* r = &regions[region_count++];
+    r->start = start;
+    r->size = size;
+    r->phys = phys;
+    r->flags = flags;
+    r->name = name;
+}
+
+// Cut [start, end) out of every tracked region (trimming or splitting them).
+static void CarveRegions(uint32_t start, uint32_t end) {
+    for (int i = 0; i < region_count; i++) {
+        VmRegion r = regions[i];
+        uint32_t r_end = r.start + r.size;
+        if (r_end <= start || r.start >= end) continue;
+
+        regions[i--] = regions[--region_count];
+        if (r.start < start) AddRegion(r.start, start - r.start, r.phys, r.flags, r.name);
+        if (r_end > end) AddRegion(end, r_end - end, r.phys + (end - r.start), r.flags, r.name);
+    }
+}
+
+// --- Public API ---
+extern "C" void MapMemory(uint32_t virt, uint32_t phys) {
+    // Legacy single-page mapping: User + RW, flushed immediately
+    SpinlockGuard guard(vm_lock);
+    virt &= 0xFFFFF000;
+    MapPages(virt, phys, virt + PAGE_SIZE, PAGE_PRESENT | PAGE_WRITE | PAGE_USER);
+    Commit();
 }
 
 void PageTableManager::MapMemory(uint32_t virt, uint32_t phys) {
     ::MapMemory(virt, phys);
 }
 
-void PageTableManager::Init() {
-    // 1. Allocate Page Directory (Aligned)
-    uint32_t raw_pd = (uint32_t)kmalloc(8192);
-    page_directory = (uint32_t*)((raw_pd + 4096) & 0xFFFFF000);
-    
-    // Clear it (Not Present)
-    for(int i = 0; i < 1024; i++) {
-        page_directory[i] = 2; // Supervisor, RW, Not Present
+bool PageTableManager::MapRange(uint32_t virt, uint32_t phys, uint32_t size, uint32_t flags, const char* name) {
+    uint32_t start = virt & 0xFFFFF000;
+    uint32_t end = (virt + size + PAGE_SIZE - 1) & 0xFFFFF000;
+    phys &= 0xFFFFF000;
+
+    SpinlockGuard guard(vm_lock);
+    bool ok = MapPages(start, phys, end, SanitizeFlags(flags));
+    CarveRegions(start, end);
+    AddRegion(start, end - start, phys, flags, name);
+    Commit();
+    return ok;
+}
+
+void PageTableManager::UnmapRange(uint32_t virt, uint32_t size) {
+    uint32_t start = virt & 0xFFFFF000;
+    uint32_t end = (virt + size + PAGE_SIZE - 1) & 0xFFFFF000;
+
+    SpinlockGuard guard(vm_lock);
+    UpdatePages(start, end, 0);
+    CarveRegions(start, end);
+    Commit();
+}
+
+bool PageTableManager::ProtectRange(uint32_t virt, uint32_t size, uint32_t flags) {
+    uint32_t start = virt & 0xFFFFF000;
+    uint32_t end = (virt + size + PAGE_SIZE - 1) & 0xFFFFF000;
+
+    SpinlockGuard guard(vm_lock);
+    UpdatePages(start, end, SanitizeFlags(flags));
+
+    // Re-tag the overlapping parts of tracked regions
+    VmRegion pieces[MAX_VM_REGIONS];
+    int n = 0;
+    for (int i = 0; i < region_count; i++) {
+        VmRegion r = regions[i];
+        uint32_t s = (r.start > start) ? r.start : start;
+        uint32_t e = (r.start + r.size < end) ? r.start + r.size : end;
+        if (s >= e) continue;
+        pieces[n] = r;
+        pieces[n].start = s;
+        pieces[n].size = e - s;
+        pieces[n].phys = r.phys + (s - r.start);
+        pieces[n].flags = flags;
+        n++;
+    }
+    CarveRegions(start, end);
+    for (int i = 0; i < n; i++) AddRegion(pieces[i].start, pieces[i].size, pieces[i].phys, pieces[i].flags, pieces[i].name);
+
+    Commit();
+    return true;
+}
+
+void PageTableManager::BeginBatch() {
+    Batch()->depth++;
+}
+
+void PageTableManager::EndBatch() {
+    TlbBatch* b = Batch();
+    if (b->depth > 0) b->depth--;
+    Commit();
+}
+
+void PageTableManager::FlushTLB() {
+    if (use_global_pages) {
+        // Toggling PGE drops every TLB entry, global ones included
+        uint32_t cr4 = CPU::ReadCR4();
+        CPU::WriteCR4(cr4 & ~CR4_PGE);
+        CPU::WriteCR4(cr4);
+    } else {
+        ReloadCR3();
     }
+}
+
+AddressSpace* PageTableManager::CreateAddressSpace() {
+    AddressSpace* space = (AddressSpace*)kmalloc(sizeof(AddressSpace));
+    if (!space) return 0;
 
-    // 2. Map the first 128MB (32 Page Tables)
-    // This covers Kernel, Heap, User Space (0x400000), and likely GRUB Modules.
-    for (int i = 0; i < 32; i++) {
-        
-        // Allocate a Page Table (Aligned)
-        uint32_t raw_pt = (uint32_t)kmalloc(8192);
-        uint32_t* pt = (uint32_t*)((raw_pt + 4096) & 0xFFFFF000);
-        
-        // Fill the table (Identity Map: Virt Addr = Phys Addr)
+    space->directory = (uint32_t*)pmm_alloc_frame();
+    if (!space->directory) { kfree(space); return 0; } // Out of Memory
+
+    for (int i = 0; i < 1024; i++) space->directory[i] = 2; // Supervisor, RW, Not Present
+    SyncKernelSlots(space);
+    space->demand_count = 0;
+    return space;
+}
+
+AddressSpace* PageTableManager::CloneAddressSpace() {
+    AddressSpace* src = Current();
+    AddressSpace* dst = CreateAddressSpace();
+    if (!dst) return 0;
+
+    for (int i = 0; i < src->demand_count; i++) dst->demand[i] = src->demand[i];
+    dst->demand_count = src->demand_count;
+
+    // Share every user page: writable ones become read-only + PAGE_COW in
+    // both spaces, so only pages that are actually written get copied.
+    for (uint32_t i = 0; i < 1024; i++) {
+        if (!IsUserSlot(i) || !(src->directory[i] & PAGE_PRESENT)) continue;
+        if (src->directory[i] & PAGE_LARGE) {
+            if (!GetTable(i)) { DestroyAddressSpace(dst); return 0; } // Share at 4KB granularity
+        }
+
+        uint32_t* child_pt = (uint32_t*)pmm_alloc_frame();
+        if (!child_pt) { DestroyAddressSpace(dst); return 0; } // Out of Memory
+
+        uint32_t* pt = (uint32_t*)(src->directory[i] & 0xFFFFF000);
         for (int j = 0; j < 1024; j++) {
-            uint32_t address = (i * 4 * 1024 * 1024) + (j * 4096); // i*4MB + j*4KB
-            
-            // Attribute: 7 (User, RW, Present)
-            // We give User Access to everything for now to allow init.bin to run easily.
-            pt[j] = address | 7; 
+            uint32_t entry = pt[j];
+            if (entry & PAGE_PRESENT) {
+                if (entry & PAGE_WRITE) {
+                    pt[j] = (entry & ~PAGE_WRITE) | PAGE_COW;
+                    QueueInvalidate((i << 22) | (j << 12), entry);
+                    entry = pt[j];
+                }
+                pmm_ref_frame(entry & 0xFFFFF000);
+            }
+            child_pt[j] = entry;
         }
+        dst->directory[i] = (uint32_t)child_pt | (src->directory[i] & (PAGE_WRITE | PAGE_USER)) | PAGE_PRESENT;
+    }
+
+    Commit(); // Parent must see its pages read-only from now on
+    return dst;
+}
+
+void PageTableManager::DestroyAddressSpace(AddressSpace* space) {
+    if (!space || space == &kernel_space) return;
+    if (space == Current()) SwitchAddressSpace(&kernel_space);
+
+    // Only user slots own anything; kernel slots point at shared tables
+    for (uint32_t i = 0; i < 1024; i++) {
+        uint32_t pde = space->directory[i];
+        if (!IsUserSlot(i) || !(pde & PAGE_PRESENT)) continue;
 
-        // Add Table to Directory
-        page_directory[i] = ((uint32_t)pt) | 7;
+        if (pde & PAGE_LARGE) {
+            pmm_free_frames(pde & 0xFFC00000, LARGE_PAGE_SIZE / PAGE_SIZE);
+            continue;
+        }
+
+        uint32_t* pt = (uint32_t*)(pde & 0xFFFFF000);
+        for (int j = 0; j < 1024; j++) {
+            if (pt[j] & PAGE_PRESENT) pmm_free_frame(pt[j] & 0xFFFFF000);
+        }
+        pmm_free_frame((uint32_t)pt);
     }
 
+    pmm_free_frame((uint32_t)space->directory);
+    kfree(space);
+}
+
+void PageTableManager::SwitchAddressSpace(AddressSpace* space) {
+    if (space == Current()) return;
+    if (space->kernel_generation != kernel_generation) SyncKernelSlots(space);
+
+    current_spaces[SMP::CpuIndex()] = space;
+    SwitchPageDirectory(space->directory); // Global kernel entries survive the reload
+}
+
+AddressSpace* PageTableManager::CurrentAddressSpace() { return Current(); }
+AddressSpace* PageTableManager::KernelAddressSpace() { return &kernel_space; }
+bool PageTableManager::IsUserAddress(uint32_t addr) { return IsUserSlot(addr >> 22); }
+
+// Would user-mode writes to every page of [addr, addr + size) succeed
+// (present and writable, copy-on-write, or a writable demand region)?
+// The kernel writes with CR0.WP, so anything else faults fatally.
+bool PageTableManager::IsUserWritable(uint32_t addr, uint32_t size) {
+    if (size == 0) return true;
+    uint32_t last = addr + size - 1;
+    if (last < addr) return false;
+
+    AddressSpace* space = Current();
+    for (uint32_t page = addr & 0xFFFFF000;; page += PAGE_SIZE) {
+        if (!IsUserSlot(page >> 22)) return false;
+
+        uint32_t entry = space->directory[page >> 22];
+        if ((entry & PAGE_PRESENT) && !(entry & PAGE_LARGE))
+            entry = ((uint32_t*)(entry & 0xFFFFF000))[(page >> 12) & 0x03FF];
+
+        if (entry & PAGE_PRESENT) {
+            if (!(entry & PAGE_USER) || !(entry & (PAGE_WRITE | PAGE_COW))) return false;
+        } else {
+            // Faulted in by the first write to it, from the first region
+            // that holds that byte (as HandlePageFault picks it)
+            uint32_t at = page < addr ? addr : page;
+            int i = 0;
+            while (i < space->demand_count && (at < space->demand[i].start || at >= space->demand[i].end)) i++;
+            if (i == space->demand_count || !(space->demand[i].flags & PAGE_WRITE)) return false;
+        }
+        if (last - page < PAGE_SIZE) return true;
+    }
+}
+
+bool PageTableManager::MapShared(uint32_t virt, uint32_t frame, uint32_t flags) {
+    virt &= 0xFFFFF000;
+    if (!IsUserSlot(virt >> 22)) return false;
+
+    SpinlockGuard guard(vm_lock);
+    if (!MapPages(virt, frame & 0xFFFFF000, virt + PAGE_SIZE, SanitizeFlags(flags) & ~PAGE_GLOBAL)) return false;
+    pmm_ref_frame(frame);
+    Commit();
+    return true;
+}
+
+bool PageTableManager::AddDemandRegion(uint32_t start, uint32_t end, uint32_t flags, const char* name,
+                                       const uint8_t* data, uint32_t data_size) {
+    AddressSpace* space = Current();
+    if (space->demand_count >= MAX_DEMAND_REGIONS) return false;
+    DemandRegion* r = &space->demand[space->demand_count++];
+    r->start = start & 0xFFFFF000;
+    r->end = end;
+    r->flags = SanitizeFlags(flags) & ~PAGE_GLOBAL; // Per-process data is never global
+    r->name = name;
+    r->data = data_size ? data : 0;
+    r->data_start = start;
+    r->data_size = data_size;
+    return true;
+}
+
+bool PageTableManager::ResizeDemandRegion(uint32_t start, uint32_t new_end) {
+    AddressSpace* space = Current();
+    for (int i = 0; i < space->demand_count; i++) {
+        DemandRegion* r = &space->demand[i];
+        if (r->start != start) continue;
+
+        // Growing is free: pages appear when first touched
+        if (new_end < r->end) {
+            uint32_t keep = (new_end + PAGE_SIZE - 1) & 0xFFFFF000;
+            uint32_t old_end = (r->end + PAGE_SIZE - 1) & 0xFFFFF000;
+            ReleasePages(keep, old_end);
+            Commit();
+        }
+        r->end = new_end;
+        return true;
+    }
+    return false;
+}
+
+bool PageTableManager::HandlePageFault(uint32_t addr, uint32_t error_code) {
+    if (error_code & PF_PRESENT) {
+        // Protection fault: only a write to a copy-on-write page is expected
+        return (error_code & PF_WRITE) && IsUserSlot(addr >> 22) && BreakCow(addr);
+    }
+
+    AddressSpace* space = Current();
+    for (int i = 0; i < space->demand_count; i++) {
+        DemandRegion* r = &space->demand[i];
+        if (addr < r->start || addr >= r->end) continue;
+
+        uint32_t frame = pmm_alloc_frame();
+        if (!frame) return false; // Out of Memory
+        ZeroFrame(frame);
+
+        uint32_t page = addr & 0xFFFFF000;
+        if (r->data) FillFromData(frame, page, r);
+        if (!MapPages(page, frame, page + PAGE_SIZE, r->flags)) {
+            pmm_free_frame(frame);
+            return false;
+        }
+        Commit(); // Was not present, so nothing is actually flushed
+        return true;
+    }
+    return false;
+}
+
+const VmRegion* PageTableManager::FindRegion(uint32_t addr) {
+    for (int i = 0; i < region_count; i++) {
+        if (addr >= regions[i].start && addr - regions[i].start < regions[i].size) return &regions[i];
+    }
+    return 0;
+}
+
+const VmRegion* PageTableManager::GetRegions(int* count) {
+    *count = region_count;
+    return regions;
+}
+
+bool PageTableManager::LargePagesEnabled() { return use_large_pages; }
+bool PageTableManager::GlobalPagesEnabled() { return use_global_pages; }
+
+void PageTableManager::Init() {
+    use_large_pages = CPU::Has(CPU::FEATURE_PSE);
+    use_global_pages = CPU::Has(CPU::FEATURE_PGE);
+
+    // 1. Allocate Page Directory (a frame is always page-aligned)
+    page_directory = (uint32_t*)pmm_alloc_frame();
+    kernel_space.directory = page_directory;
+    kernel_space.demand_count = 0;
+
+    // Clear it (Not Present)
+    for(int i = 0; i < 1024; i++) {
+        page_directory[i] = 2; // Supervisor, RW, Not Present
+    }
+
+    // 2. Identity-map the first 128MB (32 x 4MB pages, or 4KB tables without PSE)
+    // This covers Kernel, Heap and likely GRUB Modules. Kernel-only: user
+    // programs get their own image window, heap and stack per address space.
+    MapRange(0, 0, IDENTITY_MAP_SIZE, PAGE_WRITE | PAGE_GLOBAL, "identity");
+
     // 3. Register and Enable
+    // PSE must be on before the first 4MB entry is walked
+    uint32_t cr4 = CPU::ReadCR4();
+    if (use_large_pages) cr4 |= CR4_PSE;
+    CPU::WriteCR4(cr4);
+
     SwitchPageDirectory(page_directory);
     Enable();
+    kernel_dirty = false; // Nothing has copied the kernel slots yet
+
+    if (use_global_pages) CPU::WriteCR4(cr4 | CR4_PGE);
 }
 
 void PageTableManager::SwitchPageDirectory(uint32_t* directory) {
@@ -79,6 +650,6 @@ void PageTableManager::SwitchPageDirectory(uint32_t* directory) {
 void PageTableManager::Enable() {
     uint32_t cr0;
     asm volatile("mov %%cr0, %0" : "=r"(cr0));
-    cr0 |= 0x80000000;
+    cr0 |= CR0_PG | CR0_WP;
     asm volatile("mov %0, %%cr0" : : "r"(cr0));
 }
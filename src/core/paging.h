@@ -16,12 +16,123 @@ extern "C" {
     };
 }
 
+// Entry Flags (shared by directory and table entries unless noted)
+#define PAGE_PRESENT        0x001
+#define PAGE_WRITE          0x002
+#define PAGE_USER           0x004
+#define PAGE_WRITE_THROUGH  0x008
+#define PAGE_NO_CACHE       0x010
+#define PAGE_LARGE          0x080   // PDE only: 4MB page (needs CR4.PSE)
+#define PAGE_GLOBAL         0x100   // Survives CR3 reloads (needs CR4.PGE)
+#define PAGE_COW            0x200   // PTE only, software bit: read-only until copied on write
+
+#define PAGE_SIZE           0x1000
+#define LARGE_PAGE_SIZE     0x400000
+
+#define IDENTITY_MAP_SIZE   0x08000000 // First 128MB, see PMM_MAX_MEMORY
+
+// User Address Space. These directory slots are private to each address
+// space; every other slot is a copy of the kernel directory's entry.
+#define USER_IMAGE_BASE     0x00400000 // Must match programs/link.ld
+#define USER_IMAGE_END      0x00800000 // One directory slot (shadows the identity map)
+#define USER_HEAP_BASE      0x40000000
+#define USER_HEAP_LIMIT     0x80000000
+#define USER_SYSINFO_PAGE   0x80000000 // Read-only SysInfo page, just past the heap
+#define USER_STACK_TOP      0xC0000000
+#define USER_STACK_SIZE     0x00100000 // 1MB
+
+// Page-fault error code bits
+#define PF_PRESENT          0x1 // 0 = not-present page, 1 = protection violation
+#define PF_WRITE            0x2
+#define PF_USER             0x4
+
+#define MAX_VM_REGIONS      32
+#define MAX_DEMAND_REGIONS  8
+#define TLB_FLUSH_THRESHOLD 32  // Pending pages before a full flush is cheaper
+
+// A mapping created through MapRange (kept for bookkeeping/lookup)
+struct VmRegion {
+    uint32_t start;
+    uint32_t size;
+    uint32_t phys;
+    uint32_t flags;
+    const char* name;
+};
+
+// Virtual range backed lazily: the first touch of each page allocates
+// and zeroes a frame in the page-fault handler. A file-backed region then
+// copies in its share of 'data' (the bytes from data_start on; the rest,
+// like an ELF .bss, stays zero). 'data' is kernel memory that must outlive
+// the space and any forks of it.
+struct DemandRegion {
+    uint32_t start;
+    uint32_t end;
+    uint32_t flags;
+    const char* name;
+    const uint8_t* data;
+    uint32_t data_start;
+    uint32_t data_size;
+};
+
+// A page directory plus the per-process state the fault handler needs.
+struct AddressSpace {
+    uint32_t* directory;
+    uint32_t kernel_generation; // Kernel slots last copied at this generation
+    DemandRegion demand[MAX_DEMAND_REGIONS];
+    int demand_count;
+};
+
 class PageTableManager {
 public:
     static void Init();
     static void SwitchPageDirectory(uint32_t* directory);
     static void Enable();
     static void EnablePaging(); // Alias for Enable if needed, or just use Enable
-    static void MapMemory(uint32_t virt, uint32_t phys);
+    static void MapMemory(uint32_t virt, uint32_t phys); // Legacy: one 4KB page, User+RW
+
+    // Range API. Addresses/sizes are rounded out to page boundaries and
+    // flags are PAGE_* bits (PAGE_PRESENT is implied for Map/Protect).
+    // 4MB pages are used wherever virt and phys are both 4MB-aligned.
+    static bool MapRange(uint32_t virt, uint32_t phys, uint32_t size, uint32_t flags, const char* name = 0);
+    static void UnmapRange(uint32_t virt, uint32_t size);            // Frames stay with the caller
+    static bool ProtectRange(uint32_t virt, uint32_t size, uint32_t flags);
+
+    // TLB invalidation is deferred until the outermost EndBatch() (or the
+    // end of a single Map/Unmap/Protect call): one invlpg per touched page,
+    // or a single full flush past TLB_FLUSH_THRESHOLD pages. Batches are
+    // per CPU, so keep IRQs off from BeginBatch() to EndBatch().
+    static void BeginBatch();
+    static void EndBatch();
+    static void FlushTLB(); // Full flush, including global pages
+
+    // Address spaces. User slots are private and every frame mapped there
+    // belongs to the space (freed on destroy). Kernel mappings are global
+    // pages, so switching only drops the previous process's user entries.
+    static AddressSpace* CreateAddressSpace();
+    static AddressSpace* CloneAddressSpace(); // Copy-on-write duplicate of the active space
+    static void DestroyAddressSpace(AddressSpace* space);
+    static void SwitchAddressSpace(AddressSpace* space); // No CR3 write if already active
+    static AddressSpace* CurrentAddressSpace();
+    static AddressSpace* KernelAddressSpace();
+    static bool IsUserAddress(uint32_t addr);
+    static bool IsUserWritable(uint32_t addr, uint32_t size); // Active space; check before the kernel writes there
+
+    // Map a frame the kernel keeps into the active space's user slots. The
+    // space takes a reference, so tearing it down leaves the frame alone.
+    static bool MapShared(uint32_t virt, uint32_t frame, uint32_t flags);
+
+    // Demand paging (active address space).
+    // Shrinking a region releases the frames above the new end.
+    static bool AddDemandRegion(uint32_t start, uint32_t end, uint32_t flags, const char* name,
+                                const uint8_t* data = 0, uint32_t data_size = 0); // data backs [start, start + data_size)
+    static bool ResizeDemandRegion(uint32_t start, uint32_t new_end);
+    // Also resolves write faults on PAGE_COW pages.
+    static bool HandlePageFault(uint32_t addr, uint32_t error_code); // false = genuine fault
+
+    static const VmRegion* FindRegion(uint32_t addr);
+    static const VmRegion* GetRegions(int* count);
+
+    static bool LargePagesEnabled();
+    static bool GlobalPagesEnabled();
 };
 #endif
@@ -0,0 +1,54 @@
+#ifndef ELF_H
+#define ELF_H
+#include <stdint.h>
+
+// ELF32 executables: just what the process loader reads (file header and
+// program headers; sections are ignored).
+
+#define ELF_MAGIC      0x464C457F // "\x7FELF", little-endian
+#define ELFCLASS32     1
+#define ELFDATA2LSB    1
+#define ET_EXEC        2
+#define EM_386         3
+#define EV_CURRENT     1
+
+#define PT_LOAD        1
+
+#define PF_X           0x1
+#define PF_W           0x2
+#define PF_R           0x4
+
+#define ELF_MAX_LOADS  4 // PT_LOAD segments a process may have (each is a demand region)
+
+struct Elf32_Ehdr {
+    uint32_t e_magic;
+    uint8_t  e_class;
+    uint8_t  e_data;
+    uint8_t  e_ident_version;
+    uint8_t  e_ident_pad[9];
+    uint16_t e_type;
+    uint16_t e_machine;
+    uint32_t e_version;
+    uint32_t e_entry;
+    uint32_t e_phoff;
+    uint32_t e_shoff;
+    uint32_t e_flags;
+    uint16_t e_ehsize;
+    uint16_t e_phentsize;
+    uint16_t e_phnum;
+    uint16_t e_shentsize;
+    uint16_t e_shnum;
+    uint16_t e_shstrndx;
+} __attribute__((packed));
+
+struct Elf32_Phdr {
+    uint32_t p_type;
+    uint32_t p_offset;
+    uint32_t p_vaddr;
+    uint32_t p_paddr;
+    uint32_t p_filesz;
+    uint32_t p_memsz;
+    uint32_t p_flags;
+    uint32_t p_align;
+} __attribute__((packed));
+#endif
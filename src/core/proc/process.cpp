@@ -0,0 +1,225 @@
+#include "process.h"
+#include "elf.h"
+#include "../mm/kheap.h"
+#include "../mm/slab.h"
+#include "../smp.h"
+#include "../../utils/spinlock.h"
+#include "../syscall.h"
+#include "../sysinfo.h"
+#include "../../utils/memory.h"
+
+static GlobalDescriptorTable* gdt = 0;
+static SlabCache* process_cache = 0;
+static Spinlock list_lock; // process_list
+static Process* process_list = 0;
+static Process* current[MAX_CPUS]; // Per CPU: whose space is active there
+static uint32_t next_pid = 1;
+
+static void Link(Process* p) {
+    SpinlockGuard guard(list_lock);
+    p->next = process_list;
+    process_list = p;
+}
+
+void ProcessManager::Init(GlobalDescriptorTable* g) {
+    gdt = g;
+    process_cache = slab_cache_create("process", sizeof(Process), SLAB_CACHE_LINE, 0);
+}
+
+// Where 'image' is an ELF32 executable we can run: its PT_LOAD segments
+// (at most ELF_MAX_LOADS) fit the image window without sharing a page,
+// their file bytes lie inside the image, and the entry point is in one.
+static int ParseElf(const uint8_t* image, uint32_t size, const Elf32_Phdr** loads) {
+    if (size < sizeof(Elf32_Ehdr)) return -1;
+    const Elf32_Ehdr* eh = (const Elf32_Ehdr*)image;
+    if (eh->e_magic != ELF_MAGIC || eh->e_class != ELFCLASS32 || eh->e_data != ELFDATA2LSB
+        || eh->e_type != ET_EXEC || eh->e_machine != EM_386 || eh->e_version != EV_CURRENT) return -1;
+    if (eh->e_phentsize != sizeof(Elf32_Phdr) || eh->e_phoff > size
+        || eh->e_phnum > (size - eh->e_phoff) / sizeof(Elf32_Phdr)) return -1;
+
+    const Elf32_Phdr* ph = (const Elf32_Phdr*)(image + eh->e_phoff);
+    int n = 0;
+    bool entry_ok = false;
+    for (uint32_t i = 0; i < eh->e_phnum; i++) {
+        const Elf32_Phdr* seg = &ph[i];
+        if (seg->p_type != PT_LOAD || seg->p_memsz == 0) continue;
+        if (n == ELF_MAX_LOADS || seg->p_filesz > seg->p_memsz) return -1;
+        if (seg->p_offset > size || seg->p_filesz > size - seg->p_offset) return -1;
+        if (seg->p_vaddr < USER_IMAGE_BASE || seg->p_vaddr > USER_IMAGE_END
+            || seg->p_memsz > USER_IMAGE_END - seg->p_vaddr) return -1;
+
+        // Permissions are per page: no two segments may meet inside one
+        uint32_t lo = seg->p_vaddr & ~(PAGE_SIZE - 1);
+        uint32_t hi = seg->p_vaddr + seg->p_memsz;
+        for (int j = 0; j < n; j++) {
+            uint32_t other_lo = loads[j]->p_vaddr & ~(PAGE_SIZE - 1);
+            uint32_t other_hi = loads[j]->p_vaddr + loads[j]->p_memsz;
+            if (lo < ((other_hi + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1)) && other_lo < hi) return -1;
+        }
+
+        if (eh->e_entry >= seg->p_vaddr && eh->e_entry - seg->p_vaddr < seg->p_memsz) entry_ok = true;
+        loads[n++] = seg;
+    }
+    return (n && entry_ok) ? n : -1;
+}
+
+Process* ProcessManager::Create(const char* name, const uint8_t* image, uint32_t size) {
+    const Elf32_Phdr* loads[ELF_MAX_LOADS];
+    int load_count = ParseElf(image, size, loads);
+    if (load_count < 0) return 0; // Not an executable we can run
+
+    // Pages fault in from the image later, inside the process's space:
+    // an image sitting under a user slot would be shadowed there, so it
+    // gets a kernel copy (boot modules live for good: so does the copy,
+    // unless the process never comes to be)
+    uint8_t* copy = 0;
+    uint32_t src = (uint32_t)image;
+    if (PageTableManager::IsUserAddress(src) || PageTableManager::IsUserAddress(src + size - 1)) {
+        copy = (uint8_t*)kmalloc(size);
+        if (!copy) return 0;
+        memcpy(copy, image, size);
+        for (int i = 0; i < load_count; i++) loads[i] = (const Elf32_Phdr*)(copy + ((const uint8_t*)loads[i] - image));
+        image = copy;
+    }
+
+    Process* p = (Process*)slab_alloc(process_cache);
+    if (!p) {
+        kfree(copy);
+        return 0;
+    }
+
+    p->space = PageTableManager::CreateAddressSpace();
+    p->kernel_stack = (uint8_t*)kmalloc(PROCESS_KERNEL_STACK);
+    if (!p->space || !p->kernel_stack) {
+        PageTableManager::DestroyAddressSpace(p->space);
+        kfree(p->kernel_stack);
+        slab_free(process_cache, p);
+        kfree(copy);
+        return 0; // Out of Memory
+    }
+
+    p->pid = __sync_fetch_and_add(&next_pid, 1);
+    int i = 0;
+    for (; name[i] && i < PROCESS_NAME_LEN - 1; i++) p->name[i] = name[i];
+    p->name[i] = 0;
+    p->entry = ((const Elf32_Ehdr*)image)->e_entry;
+    p->heap_end = USER_HEAP_BASE;
+
+    // First run starts at the entry point on an empty user stack, IRQs on
+    uint32_t* regs = (uint32_t*)&p->context;
+    for (uint32_t r = 0; r < sizeof(TrapFrame) / 4; r++) regs[r] = 0;
+    p->context.eip = p->entry;
+    p->context.cs = gdt->UserCodeSegmentSelector();
+    p->context.eflags = 0x202;
+    p->context.user_esp = USER_STACK_TOP;
+    p->context.user_ss = gdt->UserDataSegmentSelector();
+    p->fpu.initialized = false;
+
+    // Describe the new address space from inside it. No preemption (or
+    // migration) while the active space isn't the thread's own.
+    InterruptGuard guard;
+    Process* prev = Current();
+    Switch(p);
+
+    // Nothing is copied now: each segment page faults in from the image on
+    // first touch, and the part past p_filesz (.bss) comes up zeroed.
+    // x86 pages have no execute bit, so "R E" is just read-only.
+    for (int s = 0; s < load_count; s++) {
+        const Elf32_Phdr* seg = loads[s];
+        uint32_t flags = PAGE_USER | ((seg->p_flags & PF_W) ? PAGE_WRITE : 0);
+        PageTableManager::AddDemandRegion(seg->p_vaddr, seg->p_vaddr + seg->p_memsz, flags,
+                                          (seg->p_flags & PF_W) ? "data" : "text",
+                                          image + seg->p_offset, seg->p_filesz);
+    }
+    PageTableManager::AddDemandRegion(USER_HEAP_BASE, USER_HEAP_BASE, PAGE_USER | PAGE_WRITE, "heap");
+    PageTableManager::AddDemandRegion(USER_STACK_TOP - USER_STACK_SIZE, USER_STACK_TOP, PAGE_USER | PAGE_WRITE, "stack");
+    // Programs read it without checking it is there: no page, no process
+    bool mapped = SysInfo::MapInto();
+
+    Switch(prev);
+
+    if (!mapped) {
+        PageTableManager::DestroyAddressSpace(p->space);
+        kfree(p->kernel_stack);
+        slab_free(process_cache, p);
+        kfree(copy); // No region reads from it now
+        return 0;
+    }
+    Link(p);
+    return p;
+}
+
+Process* ProcessManager::Fork(const TrapFrame* frame) {
+    Process* parent = Current();
+    if (!parent) return 0;
+
+    Process* p = (Process*)slab_alloc(process_cache);
+    if (!p) return 0;
+
+    p->space = PageTableManager::CloneAddressSpace();
+    p->kernel_stack = (uint8_t*)kmalloc(PROCESS_KERNEL_STACK);
+    if (!p->space || !p->kernel_stack) {
+        PageTableManager::DestroyAddressSpace(p->space);
+        kfree(p->kernel_stack);
+        slab_free(process_cache, p);
+        return 0; // Out of Memory
+    }
+
+    p->pid = __sync_fetch_and_add(&next_pid, 1);
+    for (int i = 0; i < PROCESS_NAME_LEN; i++) p->name[i] = parent->name[i];
+    p->entry = parent->entry;
+    p->heap_end = parent->heap_end;
+    p->context = *frame;
+    p->context.eax = 0; // fork() returns 0 in the child
+
+    FPU::Flush(); // Parent's live registers into parent->fpu first
+    p->fpu = parent->fpu;
+
+    Link(p);
+    return p;
+}
+
+void ProcessManager::Destroy(Process* p) {
+    if (!p) return;
+    if (p == Current()) Switch(0);
+
+    {
+        SpinlockGuard guard(list_lock);
+        for (Process** link = &process_list; *link; link = &(*link)->next) {
+            if (*link == p) { *link = p->next; break; }
+        }
+    }
+
+    FPU::Discard(&p->fpu);
+    PageTableManager::DestroyAddressSpace(p->space);
+    kfree(p->kernel_stack);
+    slab_free(process_cache, p);
+}
+
+void ProcessManager::Switch(Process* p) {
+    uint32_t cpu = SMP::CpuIndex();
+    PageTableManager::SwitchAddressSpace(p ? p->space : PageTableManager::KernelAddressSpace());
+    if (p && gdt) {
+        gdt->tss[cpu].esp0 = (uint32_t)p->kernel_stack + PROCESS_KERNEL_STACK;
+        Syscall::SetKernelStack(gdt->tss[cpu].esp0);
+    }
+    FPU::SwitchTo(p ? &p->fpu : 0);
+    current[cpu] = p;
+}
+
+Process* ProcessManager::Current() { return current[SMP::CpuIndex()]; }
+
+uint32_t ProcessManager::Snapshot(ProcessInfo* out, uint32_t max) {
+    SpinlockGuard guard(list_lock);
+    Process* self = Current();
+    uint32_t n = 0;
+    for (Process* p = process_list; p; p = p->next, n++) {
+        if (n >= max) continue;
+        ProcessInfo* info = &out[n];
+        info->pid = p->pid;
+        for (int i = 0; i < PROCESS_NAME_LEN; i++) info->name[i] = p->name[i];
+        info->heap_end = p->heap_end;
+        info->current = p == self;
+    }
+    return n;
+}
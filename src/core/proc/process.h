@@ -0,0 +1,68 @@
+#ifndef PROCESS_H
+#define PROCESS_H
+#include <stdint.h>
+#include "../gdt.h"
+#include "../paging.h"
+#include "../fpu.h"
+
+// User Processes
+// Each process owns an address space: its ELF segments live in the image
+// window at USER_IMAGE_BASE, with demand-paged heap and stack above it.
+// Several programs linked at the same base coexist without relocation;
+// switching between them is a CR3 load plus a TSS.esp0 update.
+
+#define PROCESS_KERNEL_STACK 8192
+#define PROCESS_NAME_LEN     16
+
+// Registers of a process stopped in a trap from ring 3, in the order the
+// interrupt stubs leave them on the kernel stack (pushad, then the iret frame).
+struct TrapFrame {
+    uint32_t edi, esi, ebp, esp, ebx, edx, ecx, eax;
+    uint32_t eip, cs, eflags, user_esp, user_ss;
+};
+
+struct Process {
+    uint32_t pid;
+    char name[PROCESS_NAME_LEN];
+    AddressSpace* space;
+    uint32_t entry;
+    uint32_t heap_end;      // Current program break (syscall 45)
+    uint8_t* kernel_stack;  // Traps from ring 3 land on top of this block
+    TrapFrame context;      // Where the process resumes when not running
+    FpuState fpu;           // Loaded lazily on the first FPU/SSE instruction
+    Process* next;
+};
+
+// A copy of a process's listing fields (ProcessManager::Snapshot)
+struct ProcessInfo {
+    uint32_t pid;
+    char name[PROCESS_NAME_LEN];
+    uint32_t heap_end;
+    bool current;           // Active on the calling CPU
+};
+
+class ProcessManager {
+public:
+    static void Init(GlobalDescriptorTable* gdt);
+
+    // Build a process from an ELF32 executable linked into the image window
+    // (0 = not one). Nothing is copied up front: segment pages fault in
+    // from 'image', which must stay put for the life of the process and
+    // its forks, and .bss is zero-filled on demand.
+    static Process* Create(const char* name, const uint8_t* image, uint32_t size);
+    static void Destroy(Process* process);
+
+    // Duplicate the current process (copy-on-write). The child resumes from
+    // 'frame' with eax = 0; returns 0 if out of memory.
+    static Process* Fork(const TrapFrame* frame);
+
+    // Make a process's address space and kernel stack active on the calling
+    // CPU (0 = kernel only). Current() is per CPU too.
+    static void Switch(Process* process);
+    static Process* Current();
+    // Copy up to 'max' processes' details out under the list lock (a
+    // process may be destroyed the moment it is dropped); returns how many
+    // exist, which may be more than were copied
+    static uint32_t Snapshot(ProcessInfo* out, uint32_t max);
+};
+#endif
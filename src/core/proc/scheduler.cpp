@@ -0,0 +1,486 @@
+#include "scheduler.h"
+#include "../cpu.h"
+#include "../smp.h"
+#include "../lapic.h"
+#include "../mm/kheap.h"
+#include "../mm/slab.h"
+#include "../../drivers/pit.h"
+
+#define EFLAGS_RESERVED 0x002 // Bit 1 always reads as one
+#define EFLAGS_IF       0x200
+
+// One per CPU. 'lock' guards the queue; the rest is only touched by its
+// own CPU (with IRQs off), except 'idling', which wakers read.
+struct RunQueue {
+    Spinlock lock;
+    Thread* head;          // FIFO of READY threads
+    Thread* tail;
+    volatile uint32_t count;
+    Thread* current;
+    Thread* idle;
+    Thread* prev;          // Switched away from, until FinishSwitch
+    uint32_t quantum_left;
+    volatile bool idling;  // Halted in Idle(): needs a kick to notice work
+    bool tick_stopped;     // Idle() stopped the tick; restarted before leaving idle
+    volatile bool online;
+};
+
+static GlobalDescriptorTable* gdt = 0;
+static SlabCache* thread_cache = 0;
+static RunQueue cpus[MAX_CPUS];
+static Spinlock thread_lock;  // all_threads and every joiners list
+static Thread* all_threads = 0;
+static uint32_t next_tid = 0;
+static uint32_t quantum_ticks = 1;
+
+static inline RunQueue* This() { return &cpus[SMP::CpuIndex()]; }
+
+// Queue operations: caller holds q->lock
+static void Push(RunQueue* q, Thread* t) {
+    t->next = 0;
+    if (q->tail) q->tail->next = t;
+    else q->head = t;
+    q->tail = t;
+    q->count++;
+}
+
+// The first thread no other CPU is still switching away from ('self', the
+// caller's own current thread, is fine). One that blocked on another CPU
+// and was woken at once stays queued until that CPU has left its stack:
+// waiting for it here, IRQs off, could wait on a CPU waiting on us.
+static Thread* Pop(RunQueue* q, Thread* self = 0) {
+    Thread* prev = 0;
+    for (Thread* t = q->head; t; prev = t, t = t->next) {
+        if (t->on_cpu && t != self) continue;
+        if (prev) prev->next = t->next;
+        else q->head = t->next;
+        if (q->tail == t) q->tail = prev;
+        t->next = 0;
+        q->count--;
+        return t;
+    }
+    return 0;
+}
+
+// Where a thread that just became ready should run: where it ran last if
+// that CPU is idle (its cache is warm) or nobody is, else an idle CPU
+static uint32_t Place(Thread* t) {
+    if (cpus[t->cpu].idling) return t->cpu;
+    for (uint32_t i = 0; i < MAX_CPUS; i++) {
+        if (cpus[i].online && cpus[i].idling) return i;
+    }
+    return t->cpu;
+}
+
+static inline uint32_t Load(RunQueue* q) {
+    return q->count + (q->current != q->idle);
+}
+
+// Home for a new thread
+static uint32_t LeastLoaded() {
+    uint32_t best = SMP::CpuIndex();
+    for (uint32_t i = 0; i < MAX_CPUS; i++) {
+        if (cpus[i].online && Load(&cpus[i]) < Load(&cpus[best])) best = i;
+    }
+    return best;
+}
+
+// Queue a thread the caller has just made READY
+static void MakeReady(Thread* t) {
+    uint32_t cpu = Place(t);
+    RunQueue* q = &cpus[cpu];
+
+    uint32_t flags = q->lock.LockIrqSave();
+    t->cpu = cpu;
+    Push(q, t);
+    q->lock.Unlock();
+    // Pairs with Idle(), which sets 'idling' before it looks at the queue
+    __sync_synchronize();
+    bool kick = q->idling;
+    CPU::RestoreInterrupts(flags);
+
+    if (kick) SMP::Kick(cpu);
+}
+
+// Take a waiting thread from the CPU with the longest queue
+static Thread* Steal(uint32_t self) {
+    RunQueue* victim = 0;
+    uint32_t most = 0;
+    for (uint32_t i = 0; i < MAX_CPUS; i++) {
+        if (i != self && cpus[i].online && cpus[i].count > most) {
+            most = cpus[i].count;
+            victim = &cpus[i];
+        }
+    }
+    if (!victim) return 0;
+
+    victim->lock.Lock();
+    Thread* t = Pop(victim);
+    victim->lock.Unlock();
+    if (t) t->cpu = self;
+    return t;
+}
+
+static bool Stealable(uint32_t self) {
+    for (uint32_t i = 0; i < MAX_CPUS; i++) {
+        if (i != self && cpus[i].count) return true;
+    }
+    return false;
+}
+
+static inline bool Transition(Thread* t, ThreadState from, ThreadState to) {
+    return __sync_bool_compare_and_swap((volatile uint32_t*)&t->state, (uint32_t)from, (uint32_t)to);
+}
+
+// Slab constructor: what every free Thread holds. Links, the timer and
+// on_cpu are back in this state by the time a thread is destroyed.
+static void ThreadCtor(void* obj) {
+    Thread* t = (Thread*)obj;
+    t->timer.pending = false;
+    t->timer.next = 0;
+    t->timer.prev = 0;
+    t->joiners = 0;
+    t->on_cpu = false;
+    t->next = 0;
+}
+
+static Thread* NewThread(const char* name) {
+    Thread* t = (Thread*)slab_alloc(thread_cache);
+    if (!t) return 0;
+
+    t->tid = __sync_fetch_and_add(&next_tid, 1);
+    int i = 0;
+    for (; name[i] && i < THREAD_NAME_LEN - 1; i++) t->name[i] = name[i];
+    t->name[i] = 0;
+    t->state = THREAD_READY;
+    t->esp = 0;
+    t->stack = 0;
+    t->owns_stack = false;
+    t->process = 0;
+    t->entry = 0;
+    t->arg = 0;
+    t->ticks = 0;
+    t->cpu = LeastLoaded();
+    return t;
+}
+
+static void Publish(Thread* t) {
+    {
+        SpinlockGuard guard(thread_lock);
+        t->all_next = all_threads;
+        all_threads = t;
+    }
+    if (t->state == THREAD_READY) MakeReady(t);
+}
+
+static void Unpublish(Thread* t) {
+    for (Thread** link = &all_threads; *link; link = &(*link)->all_next) {
+        if (*link == t) { *link = t->all_next; break; }
+    }
+}
+
+static void Destroy(Thread* t) {
+    if (t->owns_stack) kfree(t->stack);
+    if (t->process) ProcessManager::Destroy(t->process);
+    // Exit() emptied 'joiners', and no timer is pending on a dead thread
+    t->on_cpu = false;
+    t->next = 0;
+    slab_free(thread_cache, t);
+}
+
+static inline void Reschedule() {
+    asm volatile("int %0" : : "i"(SCHED_YIELD_VECTOR) : "memory");
+}
+
+// First instruction of every kernel thread, entered by iret with IRQs on
+static void ThreadStart() {
+    Thread* self = Scheduler::Current();
+    self->entry(self->arg);
+    Scheduler::Exit();
+}
+
+static void WakeTimer(void* arg) {
+    Scheduler::Wake((Thread*)arg);
+}
+
+// An idle CPU takes no ticks: the boot CPU's PIT fires at the next timer
+// deadline instead, the others' LAPIC timers stop until there is work
+static bool StopTick(uint32_t cpu) {
+    if (cpu == 0) {
+        if (PIT::StopTick(TimerWheel::BeginIdle())) return true;
+        TimerWheel::EndIdle();
+        return false;
+    }
+    LAPIC::StopTimer();
+    return true;
+}
+
+static void RestartTick(uint32_t cpu) {
+    if (cpu == 0) {
+        TimerWheel::EndIdle();
+        for (uint32_t n = PIT::RestartTick(); n; n--) TimerWheel::Tick();
+    } else {
+        LAPIC::StartTimer(PIT::Frequency());
+    }
+}
+
+// The calling context becomes 'cpu''s idle thread
+static void AdoptIdle(uint32_t cpu, uint8_t* stack) {
+    // Ring 3 needs DPL 3 data segments after the iret, and the stubs don't
+    // reload them. The flat user segment is just as valid in ring 0.
+    uint16_t user_data = gdt->UserDataSegmentSelector() | 3;
+    asm volatile("mov %0, %%ds; mov %0, %%es; mov %0, %%fs; mov %0, %%gs" : : "r"(user_data));
+
+    Thread* idle = NewThread("idle");
+    idle->state = THREAD_RUNNING;
+    idle->stack = stack;
+    idle->cpu = cpu;
+    idle->on_cpu = true;
+
+    RunQueue* q = &cpus[cpu];
+    q->idle = idle;
+    q->current = idle;
+    q->quantum_left = quantum_ticks;
+    Publish(idle);
+    q->online = true;
+}
+
+void Scheduler::Init(GlobalDescriptorTable* g) {
+    gdt = g;
+    thread_cache = slab_cache_create("thread", sizeof(Thread), SLAB_CACHE_LINE, ThreadCtor);
+
+    quantum_ticks = PIT::Frequency() * SCHED_QUANTUM_MS / 1000;
+    if (!quantum_ticks) quantum_ticks = 1;
+
+    AdoptIdle(0, 0); // kernel_main's boot stack
+}
+
+void Scheduler::InitCpu(uint32_t cpu, uint8_t* stack) {
+    AdoptIdle(cpu, stack);
+}
+
+void Scheduler::Idle() {
+    bool mwait = CPU::HasEcx(CPU::FEATURE_ECX_MONITOR);
+    uint32_t cpu = SMP::CpuIndex();
+    RunQueue* q = &cpus[cpu];
+
+    while (1) {
+        asm volatile("cli");
+        q->idling = true;
+        __sync_synchronize(); // See MakeReady(): either we see its thread, or it kicks us
+        if (!q->head && !Stealable(cpu)) {
+            q->tick_stopped = StopTick(cpu);
+            // STI holds off interrupts for one more instruction, so a wakeup
+            // can't slip in between the check and the halt
+            if (mwait) {
+                asm volatile("monitor" : : "a"(&q->head), "c"(0), "d"(0));
+                if (!q->head) asm volatile("sti; mwait" : : "a"(0), "c"(0) : "memory");
+            } else {
+                asm volatile("sti; hlt" : : : "memory");
+            }
+            asm volatile("cli");
+            // Unless an IRQ's Schedule() has already, switching away
+            if (q->tick_stopped) {
+                q->tick_stopped = false;
+                RestartTick(cpu);
+            }
+        }
+        q->idling = false;
+        asm volatile("sti");
+        if (q->head || Stealable(cpu)) Reschedule();
+    }
+}
+
+Thread* Scheduler::Spawn(const char* name, ThreadEntry entry, void* arg) {
+    Thread* t = NewThread(name);
+    uint8_t* stack = (uint8_t*)kmalloc(THREAD_STACK_SIZE);
+    if (!t || !stack) {
+        kfree(stack);
+        if (t) slab_free(thread_cache, t);
+        return 0; // Out of Memory
+    }
+    t->stack = stack;
+    t->owns_stack = true;
+    t->entry = entry;
+    t->arg = arg;
+
+    // A trap frame as the stubs would have left it: popad, then iret into
+    // ThreadStart. The word above it stands in for a return address.
+    uint32_t* sp = (uint32_t*)(stack + THREAD_STACK_SIZE);
+    *--sp = 0;
+    *--sp = EFLAGS_RESERVED | EFLAGS_IF;
+    *--sp = gdt->CodeSegmentSelector();
+    *--sp = (uint32_t)ThreadStart;
+    for (int i = 0; i < 8; i++) *--sp = 0;
+    t->esp = (uint32_t)sp;
+
+    Publish(t);
+    return t;
+}
+
+Thread* Scheduler::StartProcess(Process* p) {
+    Thread* t = NewThread(p->name);
+    if (!t) return 0;
+    t->process = p;
+    t->stack = p->kernel_stack;
+
+    // Ring-3 traps land on top of the process's kernel stack, so its first
+    // "return" from one starts there too
+    TrapFrame* frame = (TrapFrame*)(p->kernel_stack + PROCESS_KERNEL_STACK) - 1;
+    *frame = p->context;
+    t->esp = (uint32_t)frame;
+
+    Publish(t);
+    return t;
+}
+
+void Scheduler::Yield() {
+    Reschedule();
+}
+
+void Scheduler::Sleep(uint32_t ms) {
+    InterruptGuard guard;
+    Thread* self = This()->current;
+    self->state = THREAD_SLEEPING; // First: the timer may fire on another CPU at once
+    TimerWheel::Add(&self->timer, ms, WakeTimer, self);
+    Reschedule();
+}
+
+void Scheduler::Block(Spinlock* held) {
+    InterruptGuard guard;
+    This()->current->state = THREAD_BLOCKED;
+    if (held) held->Unlock();
+    Reschedule();
+}
+
+void Scheduler::Wake(Thread* t) {
+    // Of racing wakers (a timer, a wait queue), exactly one gets to queue it
+    if (!Transition(t, THREAD_SLEEPING, THREAD_READY) && !Transition(t, THREAD_BLOCKED, THREAD_READY)) return;
+    TimerWheel::Cancel(&t->timer);
+    MakeReady(t);
+}
+
+bool Scheduler::Join(uint32_t tid) {
+    InterruptGuard guard;
+    Thread* self = This()->current;
+
+    thread_lock.Lock();
+    Thread* t = all_threads;
+    while (t && t->tid != tid) t = t->all_next;
+    if (!t || t == self) {
+        thread_lock.Unlock();
+        return false;
+    }
+    self->next = t->joiners; // Not on a run queue while running
+    t->joiners = self;
+    Block(&thread_lock);     // Exit() takes the list under the same lock
+    return true;
+}
+
+void Scheduler::Exit() {
+    asm volatile("cli");
+    Thread* self = This()->current;
+
+    thread_lock.Lock();
+    Unpublish(self);
+    Thread* j = self->joiners;
+    self->joiners = 0;
+    thread_lock.Unlock();
+
+    while (j) {
+        Thread* next = j->next; // Wake() reuses the link
+        Wake(j);
+        j = next;
+    }
+
+    self->state = THREAD_DEAD;
+    Reschedule();
+    while (1); // Never resumed
+}
+
+Thread* Scheduler::Current() {
+    InterruptGuard guard; // No migrating between finding our CPU and reading it
+    return This()->current;
+}
+
+uint32_t Scheduler::Snapshot(ThreadInfo* out, uint32_t max) {
+    SpinlockGuard guard(thread_lock);
+    uint32_t n = 0;
+    for (Thread* t = all_threads; t; t = t->all_next, n++) {
+        if (n >= max) continue;
+        ThreadInfo* info = &out[n];
+        info->tid = t->tid;
+        for (int i = 0; i < THREAD_NAME_LEN; i++) info->name[i] = t->name[i];
+        info->state = t->state;
+        info->cpu = t->cpu;
+        info->ticks = t->ticks;
+    }
+    return n;
+}
+
+uint32_t Scheduler::Schedule(uint32_t esp, bool tick) {
+    uint32_t cpu = SMP::CpuIndex();
+    RunQueue* q = &cpus[cpu];
+    Thread* current = q->current;
+    if (!current) return esp; // Before Init
+    current->esp = esp;
+
+    if (tick) {
+        current->ticks++;
+        if (q->quantum_left) q->quantum_left--;
+    }
+
+    q->lock.Lock();
+    if (current->state == THREAD_RUNNING) {
+        // Keep the CPU until the quantum runs out (idle yields at once)
+        if (tick && q->quantum_left && current != q->idle) {
+            q->lock.Unlock();
+            return esp;
+        }
+        if (!q->head && current != q->idle) {
+            q->quantum_left = quantum_ticks;
+            q->lock.Unlock();
+            return esp;
+        }
+        current->state = THREAD_READY;
+        if (current != q->idle) Push(q, current);
+    }
+    // Otherwise it blocked, sleeps or died: off the queues, or already back
+    // on one if it was woken in the meantime
+    Thread* next = Pop(q, current);
+    q->lock.Unlock();
+
+    if (!next) next = Steal(cpu);
+    if (!next) next = q->idle;
+    next->state = THREAD_RUNNING;
+    q->quantum_left = quantum_ticks;
+
+    if (next != current) {
+        // An IRQ that ended the idle halt: no thread runs without a tick,
+        // and wakers must stop treating this CPU as free
+        if (current == q->idle) {
+            q->idling = false;
+            if (q->tick_stopped) {
+                q->tick_stopped = false;
+                RestartTick(cpu);
+            }
+        }
+        next->on_cpu = true; // Pop() only hands out threads no CPU is on
+        next->cpu = cpu;
+
+        if (next->process != ProcessManager::Current()) ProcessManager::Switch(next->process);
+        q->prev = current;
+        q->current = next;
+    }
+    return next->esp;
+}
+
+void Scheduler::FinishSwitch() {
+    RunQueue* q = This();
+    Thread* prev = q->prev;
+    if (!prev) return;
+    q->prev = 0;
+
+    if (prev->state == THREAD_DEAD) Destroy(prev); // Unreachable by anyone else now
+    else prev->on_cpu = false;
+}
@@ -0,0 +1,104 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+#include <stdint.h>
+#include "../gdt.h"
+#include "../timer.h"
+#include "../../utils/spinlock.h"
+#include "process.h"
+
+// Threads and Scheduling
+// Every interrupt stub saves the registers on the current stack and resumes
+// from whatever ESP HandleInterrupt returns, so a thread's whole context is
+// just the stack pointer of its last trap. Switching threads is returning
+// another thread's saved ESP. The tick (IRQ0 on the boot CPU, the LAPIC
+// timer on the others) preempts round-robin after each quantum; int 0x81
+// (kernel only) yields on demand.
+//
+// Each CPU has its own run queue and idle thread (its boot context). A
+// thread that becomes ready goes back to the CPU it last ran on, or to an
+// idle one if that CPU is busy; a CPU that runs dry steals from the
+// longest queue. Idle CPUs halt (MWAIT where the CPU has it) with their
+// tick stopped: the boot CPU's PIT fires at the next timer deadline, the
+// others sleep until an IPI brings work. A user process runs as a thread
+// on its own kernel stack, entering ring 3 through Process::context.
+//
+// A thread stays "on" its old CPU until that CPU has left its stack
+// (FinishSwitch, from the interrupt stub); no other CPU resumes it before.
+
+#define THREAD_STACK_SIZE   8192
+#define THREAD_NAME_LEN     16
+#define SCHED_QUANTUM_MS    10
+#define SCHED_YIELD_VECTOR  0x81
+
+enum ThreadState {
+    THREAD_READY,
+    THREAD_RUNNING,
+    THREAD_SLEEPING,  // Waiting on its timer
+    THREAD_BLOCKED,   // Waiting for Wake()
+    THREAD_DEAD       // Stack freed by the next switch
+};
+
+typedef void (*ThreadEntry)(void* arg);
+
+struct Thread {
+    uint32_t tid;
+    char name[THREAD_NAME_LEN];
+    ThreadState state;
+    uint32_t esp;          // Saved trap frame, while switched out
+    uint8_t* stack;        // Kernel stack block
+    bool owns_stack;       // False for process threads (stack is the process's)
+    Process* process;      // 0 = kernel thread
+    ThreadEntry entry;
+    void* arg;
+    Timer timer;           // Sleep()
+    Thread* joiners;       // Blocked in Join() on this thread
+    uint32_t ticks;        // CPU time, in timer ticks
+    uint32_t cpu;          // Run queue it is on, or last ran from
+    volatile bool on_cpu;  // Its stack is still in use by a CPU
+    Thread* next;          // Run queue / joiner / wait queue list
+    Thread* all_next;      // Every live thread
+};
+
+// A copy of a thread's listing fields (Scheduler::Snapshot)
+struct ThreadInfo {
+    uint32_t tid;
+    char name[THREAD_NAME_LEN];
+    ThreadState state;
+    uint32_t cpu;
+    uint32_t ticks;
+};
+
+class Scheduler {
+public:
+    static void Init(GlobalDescriptorTable* gdt); // Adopts the calling context as CPU 0's idle
+    static void InitCpu(uint32_t cpu, uint8_t* stack); // Same, on an AP (stack = its boot stack)
+    static void Idle();                           // The idle loop, once booted; does not return
+
+    // New kernel thread running entry(arg); it exits when entry returns.
+    static Thread* Spawn(const char* name, ThreadEntry entry, void* arg);
+    // Start a user process from its saved context (Process::context).
+    static Thread* StartProcess(Process* process);
+
+    // Calling thread only (never from IRQ handlers or the idle thread)
+    static void Yield();
+    static void Sleep(uint32_t ms);
+    static bool Join(uint32_t tid);  // false if no such thread (already gone)
+    static void Exit();              // Does not return
+    // Sleep until Wake(). Call with IRQs off, holding the lock that guards
+    // the condition checked; 'held' is dropped once a Wake can't be missed.
+    static void Block(Spinlock* held = 0);
+
+    static void Wake(Thread* thread); // Any context
+    static Thread* Current();
+    // Copy up to 'max' threads' details out under the thread list lock (a
+    // thread is freed as soon as it exits); returns how many exist, which
+    // may be more than were copied
+    static uint32_t Snapshot(ThreadInfo* out, uint32_t max);
+
+    // From HandleInterrupt: the ESP to resume. 'tick' = called for a timer tick.
+    static uint32_t Schedule(uint32_t esp, bool tick);
+    // From the interrupt stubs, on the resumed stack: releases the thread
+    // switched away from (or frees it, if it exited)
+    static void FinishSwitch();
+};
+#endif
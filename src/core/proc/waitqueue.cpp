@@ -0,0 +1,31 @@
+#include "waitqueue.h"
+#include "scheduler.h"
+
+// Blocked threads are off the run queue, so 'next' is free to link them here
+void WaitQueue::Wait() {
+    Thread* t = Scheduler::Current();
+    t->next = 0;
+    if (tail) tail->next = t;
+    else head = t;
+    tail = t;
+    Scheduler::Block(&lock); // Released only once we're marked blocked
+    lock.Lock();
+}
+
+void WaitQueue::WakeOne() {
+    Thread* t = head;
+    if (!t) return;
+    head = t->next;
+    if (!head) tail = 0;
+    Scheduler::Wake(t);
+}
+
+void WaitQueue::WakeAll() {
+    Thread* t = head;
+    head = tail = 0;
+    while (t) {
+        Thread* next = t->next; // Wake() reuses the link
+        Scheduler::Wake(t);
+        t = next;
+    }
+}
@@ -0,0 +1,23 @@
+#ifndef WAITQUEUE_H
+#define WAITQUEUE_H
+#include <stdint.h>
+#include "../../utils/spinlock.h"
+
+struct Thread;
+
+// Threads blocked until some event, in FIFO order. 'lock' guards the
+// queue and the condition waited for: waiters check it and call Wait()
+// holding the lock, wakers change it and call Wake*() holding the lock,
+// so a wakeup can't fall between the check and the sleep on any CPU.
+// Zero-initialised is empty (no constructor: globals need no ctor call).
+struct WaitQueue {
+    Spinlock lock;
+    Thread* head;
+    Thread* tail;
+
+    void Wait();    // Calling thread, holding 'lock' (IRQs off); returns holding it again
+    void WakeOne(); // Any context, holding 'lock'
+    void WakeAll();
+    bool Empty() const { return head == 0; }
+};
+#endif
@@ -2,7 +2,17 @@
 #include "../gui/TerminalWindow.h"
 #include "../fs/ext4.h"
 #include "../mm/kheap.h"
+#include "../mm/slab.h"
+#include "../proc/process.h"
+#include "../proc/scheduler.h"
 #include "../../drivers/rtc.h"
+#include "../../drivers/pit.h"
+#include "../clock.h"
+#include "../smp.h"
+#include "../interrupts.h"
+#include "../ioapic.h"
+#include "../gui/desktop.h"
+#include "../gui/input.h"
 #include "../../utils/StringHelpers.h"
 
 Shell::Shell(TerminalWindow* win) : editor(win) {
@@ -36,6 +46,10 @@ void Shell::Init() {
     CommandRegistry::Register("edit", CmdEdit);
     CommandRegistry::Register("nano", CmdNano);
     CommandRegistry::Register("export", CmdExport);
+    CommandRegistry::Register("slabinfo", CmdSlabInfo);
+    CommandRegistry::Register("ps", CmdPs);
+    CommandRegistry::Register("heaptop", CmdHeapTop);
+    CommandRegistry::Register("irq", CmdIrq);
 }
 
 void Shell::Print(const char* str) {
@@ -347,19 +361,67 @@ void Shell::CmdDate(int argc, char** argv, Shell* shell) {
 }
 
 void Shell::CmdFree(int argc, char** argv, Shell* shell) {
+    KHeapStats st;
+    kheap_stats(&st);
+
+    char num[12];
     shell->Print("Heap Status:\n");
-    // Placeholder as KHeap doesn't expose stats yet
-    shell->Print("  Total: 10MB\n");
-    shell->Print("  Used:  (Tracking pending)\n");
+    shell->Print("  Total:  "); Utils::utoa(st.heap_size / 1024, num); shell->Print(num); shell->Print(" KB\n");
+    shell->Print("  Used:   "); Utils::utoa(st.used_bytes / 1024, num); shell->Print(num);
+    shell->Print(" KB (peak "); Utils::utoa(st.peak_bytes / 1024, num); shell->Print(num); shell->Print(" KB)\n");
+    shell->Print("  Free:   "); Utils::utoa(st.free_bytes / 1024, num); shell->Print(num);
+    shell->Print(" KB in "); Utils::utoa(st.free_blocks, num); shell->Print(num);
+    shell->Print(" blocks, largest "); Utils::utoa(st.largest_free / 1024, num); shell->Print(num); shell->Print(" KB\n");
+
+    // Share of free memory unusable for a single large request
+    uint32_t pct = (st.free_bytes >= 100) ? st.largest_free / (st.free_bytes / 100) : 100;
+    if (pct > 100) pct = 100;
+    uint32_t frag = 100 - pct;
+    shell->Print("  Frag:   "); Utils::utoa(frag, num); shell->Print(num); shell->Print("%\n");
+    shell->Print("  Allocs: "); Utils::utoa(st.allocs, num); shell->Print(num);
+    shell->Print("  Frees: "); Utils::utoa(st.frees, num); shell->Print(num); shell->Print("\n");
+
+    // Live blocks per size class (block size >= class size), four per line
+    shell->Print("  Live blocks by size class:\n");
+    int col = 0;
+    for (int i = 0; i < KHEAP_SIZE_CLASSES; i++) {
+        if (!st.live_per_class[i]) continue;
+        shell->Print(col == 0 ? "    " : "  ");
+        Utils::utoa(kheap_class_size(i), num); shell->Print(num); shell->Print("B x");
+        Utils::utoa(st.live_per_class[i], num); shell->Print(num);
+        if (++col == 4) { shell->Print("\n"); col = 0; }
+    }
+    if (col) shell->Print("\n");
 }
 
 void Shell::CmdUname(int argc, char** argv, Shell* shell) {
     shell->Print("Antigravity OS v1.1 - Custom x86 Kernel\n");
     shell->Print("Build: "); shell->Print(__DATE__); shell->Print(" "); shell->Print(__TIME__); shell->Print("\n");
+    shell->Print("memcpy: "); shell->Print(memory_impl_name()); shell->Print("\n");
+    shell->Print("Clock: ");
+    if (Clock::UsesTSC()) {
+        char buf[12];
+        Utils::utoa(Clock::TscKHz() / 1000, buf);
+        shell->Print("tsc "); shell->Print(buf); shell->Print(" MHz");
+        shell->Print(Clock::Invariant() ? " (invariant)\n" : "\n");
+    } else {
+        shell->Print("pit\n");
+    }
+    char cpus[12];
+    Utils::utoa(SMP::CpuCount(), cpus);
+    shell->Print("CPUs: "); shell->Print(cpus);
+    shell->Print(InterruptManager::UsingIOAPIC() ? " (ioapic)\n" : " (pic)\n");
 }
 
 void Shell::CmdUptime(int argc, char** argv, Shell* shell) {
-    shell->Print("Uptime: (PIT Tick stats pending)\n");
+    uint32_t secs = PIT::UptimeSeconds();
+    char buf[12];
+    shell->Print("Uptime: ");
+    Utils::utoa(secs / 3600, buf); shell->Print(buf); shell->Print("h ");
+    Utils::utoa((secs / 60) % 60, buf); shell->Print(buf); shell->Print("m ");
+    Utils::utoa(secs % 60, buf); shell->Print(buf); shell->Print("s (");
+    Utils::utoa((uint32_t)PIT::Ticks(), buf); shell->Print(buf); shell->Print(" ticks at ");
+    Utils::utoa(PIT::Frequency(), buf); shell->Print(buf); shell->Print(" Hz)\n");
 }
 
 void Shell::CmdClear(int argc, char** argv, Shell* shell) {
@@ -390,7 +452,7 @@ void Shell::CmdHelp(int argc, char** argv, Shell* shell) {
     shell->Print("Available commands:\n");
     shell->Print("  Filesystem: ls, cd, cat, cp, mv, mkdir, rm, touch, pwd\n");
     shell->Print("  Editor:     edit, nano\n");
-    shell->Print("  System:     date, free, uname, uptime, export\n");
+    shell->Print("  System:     date, free, heaptop, slabinfo, ps, irq, uname, uptime, export\n");
     shell->Print("  Terminal:   clear, history, echo, help\n");
 }
 
@@ -463,3 +525,140 @@ void Shell::CmdExport(int argc, char** argv, Shell* shell) {
 
     if (k > 0) shell->SetEnv(key, val);
 }
+
+void Shell::CmdSlabInfo(int argc, char** argv, Shell* shell) {
+    shell->Print("Cache            Active/Total  ObjSize  Slabs\n");
+
+    char num[12];
+    SlabStats st;
+    for (SlabCache* c = slab_cache_next(0); c; c = slab_cache_next(c)) {
+        slab_cache_stats(c, &st);
+
+        shell->Print("  ");
+        shell->Print(st.name);
+        for (int pad = Utils::strlen(st.name); pad < 15; pad++) shell->Print(" ");
+        Utils::utoa(st.active_objects, num); shell->Print(num); shell->Print("/");
+        Utils::utoa(st.total_objects, num);  shell->Print(num); shell->Print("  ");
+        Utils::utoa(st.object_size, num);    shell->Print(num); shell->Print("  ");
+        Utils::utoa(st.slabs, num);          shell->Print(num); shell->Print("\n");
+    }
+}
+
+#define PS_MAX_ENTRIES 32 // Processes / threads listed
+
+// A count past what fit in the listing
+static void PrintMore(Shell* shell, uint32_t count) {
+    if (count <= PS_MAX_ENTRIES) return;
+    char num[12];
+    Utils::utoa(count - PS_MAX_ENTRIES, num);
+    shell->Print("  ... and "); shell->Print(num); shell->Print(" more\n");
+}
+
+void Shell::CmdPs(int argc, char** argv, Shell* shell) {
+    // Printed from copies: nothing listed can be freed under us meanwhile
+    ProcessInfo procs[PS_MAX_ENTRIES];
+    uint32_t count = ProcessManager::Snapshot(procs, PS_MAX_ENTRIES);
+    shell->Print("  PID  Name             Heap(KB)\n");
+
+    char num[12];
+    for (uint32_t i = 0; i < count && i < PS_MAX_ENTRIES; i++) {
+        ProcessInfo* p = &procs[i];
+        int len = Utils::utoa(p->pid, num);
+        for (int pad = len; pad < 5; pad++) shell->Print(" ");
+        shell->Print(num); shell->Print("  ");
+        shell->Print(p->name);
+        for (int pad = Utils::strlen(p->name); pad < 17; pad++) shell->Print(" ");
+        Utils::utoa((p->heap_end - USER_HEAP_BASE) / 1024, num); shell->Print(num);
+        shell->Print(p->current ? " *\n" : "\n");
+    }
+    PrintMore(shell, count);
+
+    ThreadInfo threads[PS_MAX_ENTRIES];
+    count = Scheduler::Snapshot(threads, PS_MAX_ENTRIES);
+    static const char* states[] = { "ready", "running", "sleeping", "blocked", "dead" };
+    shell->Print("\n  TID  Name             State     CPU  Ticks\n");
+    for (uint32_t i = 0; i < count && i < PS_MAX_ENTRIES; i++) {
+        ThreadInfo* t = &threads[i];
+        int len = Utils::utoa(t->tid, num);
+        for (int pad = len; pad < 5; pad++) shell->Print(" ");
+        shell->Print(num); shell->Print("  ");
+        shell->Print(t->name);
+        for (int pad = Utils::strlen(t->name); pad < 17; pad++) shell->Print(" ");
+        shell->Print(states[t->state]);
+        for (int pad = Utils::strlen(states[t->state]); pad < 10; pad++) shell->Print(" ");
+        len = Utils::utoa(t->cpu, num);
+        shell->Print(num);
+        for (int pad = len; pad < 5; pad++) shell->Print(" ");
+        Utils::utoa(t->ticks, num); shell->Print(num);
+        shell->Print("\n");
+    }
+    PrintMore(shell, count);
+}
+
+// irq: where each ISA IRQ goes; irq <n> <cpu>: move one
+void Shell::CmdIrq(int argc, char** argv, Shell* shell) {
+    char stat[12];
+    shell->Print("Input: ");
+    Utils::utoa(Desktop::InputLatencyUs(), stat);
+    shell->Print(stat);
+    shell->Print("us to the last frame, ");
+    Utils::utoa(InputQueue::Dropped(), stat);
+    shell->Print(stat);
+    shell->Print(" events dropped\n");
+
+    if (!InterruptManager::UsingIOAPIC()) {
+        shell->Print("IRQs go through the 8259 PIC to CPU 0.\n");
+        return;
+    }
+
+    if (argc == 3) {
+        uint32_t irq, cpu;
+        if (!Utils::atou(argv[1], &irq) || !Utils::atou(argv[2], &cpu) || irq >= ACPI_ISA_IRQS
+            || !InterruptManager::SetAffinity(irq, cpu))
+            shell->Print("Usage: irq [<irq> <cpu>] (not IRQ 0; cpu < CPU count)\n");
+        return;
+    }
+
+    shell->Print("  IRQ  Vector  CPU\n");
+    char num[12];
+    for (uint8_t irq = 0; irq < ACPI_ISA_IRQS; irq++) {
+        uint8_t vector, apic_id;
+        if (!IOAPIC::IsaRoute(irq, &vector, &apic_id)) continue;
+
+        uint32_t cpu = 0;
+        while (cpu < SMP::CpuCount() && SMP::ApicId(cpu) != apic_id) cpu++;
+
+        int len = Utils::utoa(irq, num);
+        for (int pad = len; pad < 5; pad++) shell->Print(" ");
+        shell->Print(num); shell->Print("    0x");
+        Utils::xtoa(vector, num); shell->Print(num + 6);
+        Utils::utoa(cpu, num); shell->Print("  "); shell->Print(num); shell->Print("\n");
+    }
+}
+
+void Shell::CmdHeapTop(int argc, char** argv, Shell* shell) {
+    if (argc > 1) {
+        if (Utils::strcmp(argv[1], "on") == 0) { kheap_profile(true); shell->Print("Allocation-site profiling on.\n"); }
+        else if (Utils::strcmp(argv[1], "off") == 0) { kheap_profile(false); shell->Print("Allocation-site profiling off.\n"); }
+        else shell->Print("Usage: heaptop [on|off]\n");
+        return;
+    }
+
+    if (!kheap_profiling()) shell->Print("(profiling off, showing last samples; 'heaptop on' to record)\n");
+
+    KHeapSite top[10];
+    int n = kheap_top_sites(top, 10);
+    if (n == 0) { shell->Print("No samples.\n"); return; }
+
+    shell->Print("  Caller      Allocs     Bytes\n");
+    char num[12];
+    for (int i = 0; i < n; i++) {
+        shell->Print("  0x"); Utils::xtoa((uint32_t)top[i].caller, num); shell->Print(num);
+        int len = Utils::utoa(top[i].allocs, num);
+        for (int pad = len; pad < 8; pad++) shell->Print(" ");
+        shell->Print(num);
+        len = Utils::utoa(top[i].bytes, num);
+        for (int pad = len; pad < 10; pad++) shell->Print(" ");
+        shell->Print(num); shell->Print("\n");
+    }
+}
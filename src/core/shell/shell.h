@@ -65,6 +65,10 @@ public:
     static void CmdEdit(int argc, char** argv, Shell* shell);
     static void CmdNano(int argc, char** argv, Shell* shell);
     static void CmdExport(int argc, char** argv, Shell* shell);
+    static void CmdSlabInfo(int argc, char** argv, Shell* shell);
+    static void CmdPs(int argc, char** argv, Shell* shell);
+    static void CmdHeapTop(int argc, char** argv, Shell* shell);
+    static void CmdIrq(int argc, char** argv, Shell* shell);
 };
 
 #endif
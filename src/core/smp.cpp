@@ -0,0 +1,127 @@
+#include "smp.h"
+#include "cpu.h"
+#include "fpu.h"
+#include "clock.h"
+#include "lapic.h"
+#include "acpi.h"
+#include "paging.h"
+#include "interrupts.h"
+#include "syscall.h"
+#include "mm/kheap.h"
+#include "proc/scheduler.h"
+#include "../drivers/pit.h"
+#include "../utils/memory.h"
+
+#define INIT_DELAY_US  10000
+#define SIPI_DELAY_US  200
+#define ARRIVAL_US     100000 // Listed CPUs that haven't shown up by then never will
+
+// Trampoline parameter block (ap_params in ap_boot.asm)
+struct ApParams {
+    uint32_t cr3;
+    uint32_t cr4;
+    uint32_t entry;
+    uint32_t stacks;
+    uint32_t stack_size;
+    uint32_t next;  // Next CPU index to hand out
+    uint32_t max;
+};
+
+extern "C" uint8_t ap_trampoline_start[];
+extern "C" uint8_t ap_trampoline_end[];
+extern "C" uint8_t ap_params[];
+
+GlobalDescriptorTable* SMP::gdt = 0;
+volatile uint32_t SMP::count = 1;
+uint8_t SMP::apic_ids[MAX_CPUS];
+static uint8_t* ap_stacks = 0; // CPU n's is the (n-1)-th block
+
+void SMP::Init(GlobalDescriptorTable* g) {
+    gdt = g;
+    if (!LAPIC::Init()) return; // No APIC: uniprocessor
+    apic_ids[0] = LAPIC::Id();
+
+    ap_stacks = (uint8_t*)kmalloc((MAX_CPUS - 1) * SMP_AP_STACK);
+    if (!ap_stacks) return;
+
+    uint32_t size = ap_trampoline_end - ap_trampoline_start;
+    memcpy((void*)SMP_TRAMPOLINE, ap_trampoline_start, size);
+
+    // The copy's parameter block, at the same offset as in the image
+    ApParams* params = (ApParams*)(SMP_TRAMPOLINE + (ap_params - ap_trampoline_start));
+    params->cr3 = (uint32_t)PageTableManager::KernelAddressSpace()->directory;
+    params->cr4 = CPU::ReadCR4();
+    params->entry = (uint32_t)ApMain;
+    params->stacks = (uint32_t)ap_stacks; // CPU n's stack top: stacks + n * size
+    params->stack_size = SMP_AP_STACK;
+    params->next = 1;
+    params->max = MAX_CPUS;
+
+    // INIT, then two startup IPIs (the second only for CPUs that missed the first)
+    if (ACPI::HasMadt()) {
+        StartListed();
+        return;
+    }
+    LAPIC::BroadcastInit();
+    Clock::DelayUs(INIT_DELAY_US);
+    LAPIC::BroadcastStartup(SMP_TRAMPOLINE >> 12);
+    Clock::DelayUs(SIPI_DELAY_US);
+    LAPIC::BroadcastStartup(SMP_TRAMPOLINE >> 12);
+
+    // Nothing says how many CPUs there are: wait until arrivals stop
+    uint32_t seen = count;
+    uint64_t quiet = Clock::Deadline(SMP_QUIET_US);
+    while (!Clock::Expired(quiet)) {
+        if (count != seen) {
+            seen = count;
+            quiet = Clock::Deadline(SMP_QUIET_US);
+        }
+        asm volatile("pause");
+    }
+}
+
+// The MADT's processors, by APIC ID: only as many as there are CPU slots
+void SMP::StartListed() {
+    uint8_t self = apic_ids[0];
+    uint32_t expected = 1;
+    for (uint32_t i = 0; i < ACPI::CpuCount() && expected < MAX_CPUS; i++) {
+        if (ACPI::CpuApicId(i) == self) continue;
+        LAPIC::SendInit(ACPI::CpuApicId(i));
+        expected++;
+    }
+    Clock::DelayUs(INIT_DELAY_US);
+
+    for (int round = 0; round < 2; round++) {
+        uint32_t sent = 1;
+        for (uint32_t i = 0; i < ACPI::CpuCount() && sent < expected; i++) {
+            if (ACPI::CpuApicId(i) == self) continue;
+            LAPIC::SendStartup(ACPI::CpuApicId(i), SMP_TRAMPOLINE >> 12);
+            sent++;
+        }
+        Clock::DelayUs(SIPI_DELAY_US);
+    }
+
+    uint64_t deadline = Clock::Deadline(ARRIVAL_US);
+    while (count < expected && !Clock::Expired(deadline)) asm volatile("pause");
+}
+
+// Entered from the trampoline on the AP's own stack, IRQs off
+void SMP::ApMain(uint32_t cpu) {
+    gdt->Load(cpu);
+    InterruptManager::LoadIDT();
+    FPU::Init();
+    Syscall::InitCpu();
+    LAPIC::InitCpu();
+    apic_ids[cpu] = LAPIC::Id();
+
+    Scheduler::InitCpu(cpu, ap_stacks + (cpu - 1) * SMP_AP_STACK);
+
+    __sync_fetch_and_add(&count, 1);
+    LAPIC::StartTimer(PIT::Frequency());
+    asm volatile("sti");
+    Scheduler::Idle();
+}
+
+void SMP::Kick(uint32_t cpu) {
+    if (LAPIC::Present() && cpu != CpuIndex()) LAPIC::SendIPI(apic_ids[cpu], LAPIC_RESCHED_VECTOR);
+}
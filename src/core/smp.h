@@ -0,0 +1,45 @@
+#ifndef SMP_H
+#define SMP_H
+#include <stdint.h>
+#include "gdt.h"
+
+// Symmetric Multiprocessing
+// The boot CPU wakes the others (APs) with INIT + startup IPIs through its
+// local APIC: to each processor the ACPI MADT lists, or broadcast (then
+// counted as they arrive) on machines without one. Each AP runs the real-mode trampoline (ap_boot.asm) into
+// protected mode on the kernel page directory, loads the shared GDT/IDT
+// with its own TSS, and becomes an idle thread in the scheduler, which
+// spreads threads over every online CPU.
+//
+// A CPU's index (0 = boot CPU) is read from its task register: each has
+// its own TSS selector, so this needs no memory access and no locking.
+
+#define SMP_TRAMPOLINE  0x8000 // Real-mode entry page (below 1MB, reserved at boot)
+#define SMP_AP_STACK    8192   // Boot (= idle) stack of each AP
+#define SMP_QUIET_US    20000  // No new AP for this long: all have arrived
+
+class SMP {
+public:
+    // Boot CPU, with interrupts on and the scheduler running
+    static void Init(GlobalDescriptorTable* gdt);
+
+    static uint32_t CpuCount() { return count; } // Online CPUs
+    static uint32_t CpuIndex() {
+        uint16_t tr;
+        asm volatile("str %0" : "=r"(tr));
+        return tr >= GDT_TSS_SELECTOR ? (uint32_t)(tr - GDT_TSS_SELECTOR) >> 3 : 0;
+    }
+    static uint8_t ApicId(uint32_t cpu) { return apic_ids[cpu]; }
+
+    // Make another CPU take a look at its run queue (wakes it from HLT)
+    static void Kick(uint32_t cpu);
+
+private:
+    static void StartListed();
+    static void ApMain(uint32_t cpu);
+
+    static GlobalDescriptorTable* gdt;
+    static volatile uint32_t count;
+    static uint8_t apic_ids[MAX_CPUS];
+};
+#endif
@@ -0,0 +1,224 @@
+#include "syscall.h"
+#include "interrupts.h"
+#include "paging.h"
+#include "cpu.h"
+#include "smp.h"
+#include "clock.h"
+#include "sysinfo.h"
+#include "proc/process.h"
+#include "proc/scheduler.h"
+#include "graphics/console.h"
+#include "../drivers/keyboard.h"
+#include "../utils/math.h"
+#include "../utils/memory.h"
+
+#define MSR_SYSENTER_CS  0x174
+#define MSR_SYSENTER_ESP 0x175
+#define MSR_SYSENTER_EIP 0x176
+
+#define WRITE_CHUNK 512 // Bytes copied in per Console::Write
+
+#define CLOCK_REALTIME  0
+#define CLOCK_MONOTONIC 1
+#define CLOCK_BOOTTIME  7
+
+SyscallHandler Syscall::table[SYSCALL_COUNT];
+bool Syscall::sysenter = false;
+
+static GlobalDescriptorTable* gdt = 0;
+static uint32_t sysenter_stack[MAX_CPUS]; // Last value written to MSR_SYSENTER_ESP
+
+static bool UserRange(uint32_t addr, uint32_t size) {
+    return size == 0 || (addr + size - 1 >= addr && PageTableManager::IsUserAddress(addr)
+                         && PageTableManager::IsUserAddress(addr + size - 1));
+}
+
+// Buffers the kernel writes into: read-only program pages would fault
+// under CR0.WP, so they are turned away here instead
+static bool UserWritable(uint32_t addr, uint32_t size) { return PageTableManager::IsUserWritable(addr, size); }
+
+// Syscall 1: EXIT
+// The thread is reaped (and its process destroyed) after the switch.
+static uint32_t SysExit(uint32_t, uint32_t, uint32_t, TrapFrame*) {
+    Scheduler::Exit();
+    return 0;
+}
+
+// Syscall 2: FORK
+// Returns: child PID to the parent, 0 in the child, -1 on failure
+// Pages are shared copy-on-write, so this is page-table work only.
+static uint32_t SysFork(uint32_t, uint32_t, uint32_t, TrapFrame* frame) {
+    Process* child = ProcessManager::Fork(frame);
+    if (child && !Scheduler::StartProcess(child)) {
+        ProcessManager::Destroy(child);
+        child = 0;
+    }
+    return child ? child->pid : (uint32_t)-1;
+}
+
+// Syscall 3: READ (Linux Standard)
+// ebx = fd (ignored: the keyboard), ecx = buffer, edx = count
+// Sleeps until a key is typed, then returns everything queued (up
+// to count, at most KEYBOARD_READ_CHUNK) in one go. ecx = 0 reads a single key into EAX instead.
+static uint32_t SysRead(uint32_t, uint32_t buf, uint32_t count, TrapFrame*) {
+    if (buf == 0) {
+        char c;
+        Keyboard::Read(&c, 1);
+        return c;
+    }
+    if (count == 0) return 0;
+    if (!UserWritable(buf, count)) return (uint32_t)-EFAULT;
+    return Keyboard::Read((char*)buf, count);
+}
+
+// Output goes through a kernel copy, a chunk at a time: user pages may
+// still have to fault in, which must not happen under the console lock
+static void WriteOut(uint32_t buf, uint32_t count) {
+    char chunk[WRITE_CHUNK];
+    while (count) {
+        uint32_t n = count < WRITE_CHUNK ? count : WRITE_CHUNK;
+        memcpy(chunk, (const void*)buf, n);
+        Console::Write(chunk, n);
+        buf += n;
+        count -= n;
+    }
+}
+
+// Syscall 4: WRITE (Linux Standard)
+// ebx = file (ignored: the console), ecx = buffer, edx = count
+// Returns the bytes written.
+static uint32_t SysWrite(uint32_t, uint32_t buf, uint32_t count, TrapFrame*) {
+    if (!UserRange(buf, count)) return (uint32_t)-EFAULT;
+    WriteOut(buf, count);
+    return count;
+}
+
+// Syscall 146: WRITEV (Linux Standard)
+// ebx = file (ignored: the console), ecx = struct iovec*, edx = count
+// Every buffer is checked before any is written. Returns the total bytes.
+static uint32_t SysWritev(uint32_t, uint32_t iov_addr, uint32_t iovcnt, TrapFrame*) {
+    if (iovcnt > IOV_MAX) return (uint32_t)-EINVAL;
+    if (!UserRange(iov_addr, iovcnt * sizeof(IoVec))) return (uint32_t)-EFAULT;
+
+    const IoVec* iov = (const IoVec*)iov_addr;
+    uint32_t total = 0;
+    for (uint32_t i = 0; i < iovcnt; i++) {
+        if (!UserRange(iov[i].base, iov[i].len)) return (uint32_t)-EFAULT;
+        if (total + iov[i].len < total || (int32_t)(total + iov[i].len) < 0) return (uint32_t)-EINVAL;
+        total += iov[i].len;
+    }
+    // Written as they are read again: only ever what was checked
+    uint32_t done = 0;
+    for (uint32_t i = 0; i < iovcnt; i++) {
+        IoVec v = iov[i];
+        if (!UserRange(v.base, v.len) || v.len > total - done) break;
+        WriteOut(v.base, v.len);
+        done += v.len;
+    }
+    return done;
+}
+
+// Syscall 45: BRK / SBRK (Heap Allocation)
+// ebx = increment amount (bytes, may be negative)
+// Returns: Pointer to OLD break (start of new block), or NULL
+// O(1): only the region bound moves; pages are faulted in on first touch.
+static uint32_t SysBrk(uint32_t incr, uint32_t, uint32_t, TrapFrame*) {
+    Process* proc = ProcessManager::Current();
+    uint32_t old_break = proc ? proc->heap_end : 0;
+    uint32_t new_break = old_break + (int32_t)incr;
+
+    bool in_range = ((int32_t)incr >= 0) ? (new_break >= old_break && new_break <= USER_HEAP_LIMIT)
+                                          : (new_break >= USER_HEAP_BASE && new_break <= old_break);
+    if (!proc || !in_range || !PageTableManager::ResizeDemandRegion(USER_HEAP_BASE, new_break)) return 0;
+    proc->heap_end = new_break;
+    return old_break;
+}
+
+// Syscall 88: REBOOT
+static uint32_t SysReboot(uint32_t, uint32_t, uint32_t, TrapFrame*) {
+    // Pulse the Keyboard Controller to reset CPU
+    uint8_t good = 0x02;
+    while (good & 0x02)
+        good = InterruptManager::ReadPort(0x64);
+    InterruptManager::WritePort(0x64, 0xFE);
+    // CPU halts here and reboots
+    return 0;
+}
+
+// Syscall 265: CLOCK_GETTIME
+// ebx = clock id, ecx = struct timespec* { seconds, nanoseconds }
+// Wall time is the RTC at boot plus the monotonic clock. Programs can read
+// the same without a syscall from the SysInfo page.
+static uint32_t SysClockGettime(uint32_t clock, uint32_t ts_addr, uint32_t, TrapFrame*) {
+    if (clock != CLOCK_REALTIME && clock != CLOCK_MONOTONIC && clock != CLOCK_BOOTTIME) return (uint32_t)-EINVAL;
+    if (!UserWritable(ts_addr, 8)) return (uint32_t)-EFAULT;
+    uint32_t rem;
+    uint32_t* ts = (uint32_t*)ts_addr;
+    ts[0] = (uint32_t)udiv64(Clock::Nanoseconds(), 1000000000, &rem);
+    ts[1] = rem;
+    if (clock == CLOCK_REALTIME) ts[0] += SysInfo::BootTime();
+    return 0;
+}
+
+void Syscall::Register(uint32_t num, SyscallHandler handler) { table[num] = handler; }
+
+void Syscall::Init(GlobalDescriptorTable* g) {
+    gdt = g;
+    Register(SYS_EXIT, SysExit);
+    Register(SYS_FORK, SysFork);
+    Register(SYS_READ, SysRead);
+    Register(SYS_WRITE, SysWrite);
+    Register(SYS_BRK, SysBrk);
+    Register(SYS_REBOOT, SysReboot);
+    Register(SYS_WRITEV, SysWritev);
+    Register(SYS_CLOCK_GETTIME, SysClockGettime);
+
+    sysenter = SysenterUsable();
+    InitCpu();
+}
+
+// CPUID reports SEP on the Pentium Pro too, which has no working SYSENTER
+// (family 6, model < 3, stepping < 3)
+bool Syscall::SysenterUsable() {
+    if (!CPU::Has(CPU::FEATURE_SEP) || !CPU::Has(CPU::FEATURE_MSR)) return false;
+    uint32_t sig = CPU::Signature();
+    uint32_t family = (sig >> 8) & 0xF, model = (sig >> 4) & 0xF, stepping = sig & 0xF;
+    return !(family == 6 && model < 3 && stepping < 3);
+}
+
+// SYSEXIT derives the user selectors from MSR_SYSENTER_CS (+16 code, +24
+// stack), which is where the GDT keeps them
+void Syscall::InitCpu() {
+    if (!sysenter) return;
+    CPU::WriteMSR(MSR_SYSENTER_CS, gdt->CodeSegmentSelector());
+    CPU::WriteMSR(MSR_SYSENTER_EIP, (uint32_t)&SysenterEntry);
+    CPU::WriteMSR(MSR_SYSENTER_ESP, 0);
+    sysenter_stack[SMP::CpuIndex()] = 0;
+}
+
+void Syscall::SetKernelStack(uint32_t top) {
+    if (!sysenter) return;
+    uint32_t cpu = SMP::CpuIndex();
+    if (sysenter_stack[cpu] == top) return; // Same process again: skip the WRMSR
+    CPU::WriteMSR(MSR_SYSENTER_ESP, top);
+    sysenter_stack[cpu] = top;
+}
+
+void Syscall::Dispatch(TrapFrame* frame) {
+    uint32_t num = frame->eax;
+    SyscallHandler handler = num < SYSCALL_COUNT ? table[num] : 0;
+    frame->eax = handler ? handler(frame->ebx, frame->ecx, frame->edx, frame) : (uint32_t)-ENOSYS;
+}
+
+// The stub left eip blank and user_esp at the caller's EBP: the resume
+// address is on top of that stack
+uint32_t Syscall::HandleSysenter(uint32_t esp) {
+    TrapFrame* frame = (TrapFrame*)esp;
+    uint32_t sp = frame->user_esp;
+    if (!UserRange(sp, 4)) Scheduler::Exit(); // Nowhere to return to
+
+    frame->eip = *(uint32_t*)sp;
+    frame->user_esp = sp + 4;
+    Dispatch(frame);
+    return esp;
+}
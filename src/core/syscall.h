@@ -0,0 +1,72 @@
+#ifndef SYSCALL_H
+#define SYSCALL_H
+#include <stdint.h>
+#include "gdt.h"
+#include "proc/process.h"
+
+// System Calls
+// Two ways in, one table. int 0x80 keeps working for everything; where the
+// CPU has SYSENTER (CPUID SEP) it is the fast path: no IDT lookup or
+// privilege checks on entry, and SYSEXIT back when the thread didn't
+// switch. Both build the same TrapFrame, so fork() and exit() need not
+// care which was used.
+//
+// Arguments: EAX = number, EBX, ECX, EDX = arguments 1-3; the result goes
+// back in EAX. SYSEXIT resumes from EDX/ECX, so through SYSENTER those
+// two are clobbered, and the caller passes its stack pointer in EBP with
+// the address to resume at on top of that stack:
+//     push ebp; push resume; mov ebp, esp; sysenter
+//     resume: pop ebp
+// User code decides with the same CPUID test as SysenterUsable(): the
+// kernel turns SYSENTER on whenever it passes.
+
+// Numbers (Linux i386)
+#define SYS_EXIT          1
+#define SYS_FORK          2
+#define SYS_READ          3
+#define SYS_WRITE         4
+#define SYS_BRK           45
+#define SYS_REBOOT        88
+#define SYS_WRITEV        146
+#define SYS_CLOCK_GETTIME 265
+#define SYSCALL_COUNT     266 // Highest number + 1
+
+// Errors, returned negated
+#define EFAULT 14
+#define EINVAL 22
+#define ENOSYS 38
+
+#define IOV_MAX 1024 // writev() buffers per call
+
+// One writev() buffer, as user code lays it out
+struct IoVec {
+    uint32_t base;
+    uint32_t len;
+};
+
+// Arguments 1-3, and the caller's whole frame (fork needs it)
+typedef uint32_t (*SyscallHandler)(uint32_t a1, uint32_t a2, uint32_t a3, TrapFrame* frame);
+
+class Syscall {
+public:
+    static void Init(GlobalDescriptorTable* gdt); // Table, and SYSENTER on the boot CPU
+    static void InitCpu();                        // SYSENTER on an AP
+    static bool SysenterUsable();
+
+    // SYSENTER's stack on the calling CPU: the current process's kernel
+    // stack top, alongside TSS.esp0 (ProcessManager::Switch)
+    static void SetKernelStack(uint32_t top);
+
+    // Run the call 'frame' asks for and store its result in frame->eax
+    static void Dispatch(TrapFrame* frame);
+
+    // From the SYSENTER stub: the ESP to resume (as HandleInterrupt)
+    static uint32_t HandleSysenter(uint32_t esp);
+    static void SysenterEntry(); // The stub itself (syscall_asm.asm)
+
+private:
+    static void Register(uint32_t num, SyscallHandler handler);
+    static SyscallHandler table[SYSCALL_COUNT];
+    static bool sysenter;
+};
+#endif
@@ -0,0 +1,46 @@
+[BITS 32]
+section .text
+extern _ZN7Syscall14HandleSysenterEj ; Syscall::HandleSysenter
+extern _ZN9Scheduler12FinishSwitchEv ; Scheduler::FinishSwitch
+global _ZN7Syscall13SysenterEntryEv
+
+USER_CS equ 0x1B ; GDT user code | RPL 3
+USER_SS equ 0x23 ; GDT user data | RPL 3
+EFLAGS_IF equ 0x200
+
+; SYSENTER lands here on the process's kernel stack (MSR 0x175) with IRQs
+; off and nothing saved. Build the frame an int 0x80 from ring 3 would
+; have left, so the rest of the kernel sees one kind of trap. The caller's
+; stack pointer is in EBP; HandleSysenter takes the resume address off it.
+_ZN7Syscall13SysenterEntryEv:
+    push dword USER_SS
+    push ebp                    ; user_esp
+    pushfd
+    or dword [esp], EFLAGS_IF   ; User code always runs with IRQs on
+    push dword USER_CS
+    push dword 0                ; eip: filled in by HandleSysenter
+    pushad
+
+    push esp                    ; Arg: the frame
+    call _ZN7Syscall14HandleSysenterEj
+    add esp, 4
+
+    cmp eax, esp
+    jne .switched
+
+    ; Same thread: SYSEXIT, to EIP = EDX and ESP = ECX (clobbered by contract)
+    popad
+    mov edx, [esp]              ; eip
+    mov ecx, [esp + 12]         ; user_esp
+    push dword [esp + 8]        ; eflags, minus IF until we are out
+    and dword [esp], ~EFLAGS_IF
+    popfd
+    sti                         ; Holds IRQs off for one more instruction
+    sysexit
+
+    ; Resuming another thread, which may have trapped any way: the generic exit
+.switched:
+    mov esp, eax
+    call _ZN9Scheduler12FinishSwitchEv
+    popad
+    iretd
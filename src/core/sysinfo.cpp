@@ -0,0 +1,56 @@
+#include "sysinfo.h"
+#include "cpu.h"
+#include "smp.h"
+#include "clock.h"
+#include "paging.h"
+#include "mm/pmm.h"
+#include "../drivers/pit.h"
+#include "../drivers/rtc.h"
+#include "../utils/math.h"
+
+SysInfoPage* SysInfo::page = 0;
+
+void SysInfo::Init() {
+    uint32_t frame = pmm_alloc_frame();
+    if (!frame) return; // Out of Memory: MapInto() fails, and so does every process
+
+    // The kernel writes it through the identity map
+    uint32_t* words = (uint32_t*)frame;
+    for (uint32_t i = 0; i < PAGE_SIZE / 4; i++) words[i] = 0;
+    SysInfoPage* p = (SysInfoPage*)frame;
+
+    p->version = SYSINFO_VERSION;
+    p->ns_per_cycle = Clock::UsesTSC() ? Clock::NsPerCycle() : 0;
+    p->tick_hz = PIT::Frequency();
+    p->boot_time = RTC::UnixTime() - (uint32_t)udiv64(Clock::Nanoseconds(), 1000000000, 0);
+    p->cpu_signature = CPU::Signature();
+    p->cpu_features_edx = CPU::FeaturesEdx();
+    p->cpu_features_ecx = CPU::FeaturesEcx();
+    p->tsc_khz = Clock::UsesTSC() ? Clock::TscKHz() : 0;
+    const char* vendor = CPU::Vendor();
+    for (int i = 0; vendor[i] && i < 15; i++) p->cpu_vendor[i] = vendor[i];
+
+    page = p;
+    Update();
+}
+
+void SysInfo::Update() {
+    SysInfoPage* p = page;
+    if (!p) return;
+
+    p->seq = p->seq + 1; // Odd: readers retry
+    asm volatile("" : : : "memory");
+
+    uint64_t tsc = Clock::UsesTSC() ? CPU::ReadTSC() : 0;
+    p->mono_ns = tsc ? Clock::FromTSC(tsc) : Clock::Nanoseconds();
+    p->tsc = tsc;
+    p->ticks = PIT::Ticks();
+    p->cpu_count = SMP::CpuCount();
+
+    asm volatile("" : : : "memory"); // x86 keeps stores in order; the compiler must too
+    p->seq = p->seq + 1;
+}
+
+bool SysInfo::MapInto() {
+    return page && PageTableManager::MapShared(USER_SYSINFO_PAGE, (uint32_t)page, PAGE_USER);
+}
@@ -0,0 +1,51 @@
+#ifndef SYSINFO_H
+#define SYSINFO_H
+#include <stdint.h>
+
+// Shared Info Page (vDSO-style)
+// One frame the kernel rewrites on every boot-CPU tick, mapped read-only
+// at USER_SYSINFO_PAGE in every process, so user code reads the clock
+// and basic system facts without a syscall.
+//
+// Readers use the sequence count: read 'seq', the fields, then 'seq'
+// again; retry while it was odd or changed. Between ticks, monotonic time
+// is mono_ns plus the TSC cycles since 'tsc' (converted with
+// ns_per_cycle, 32.32 fixed point); tsc = 0 means no usable TSC, and
+// mono_ns is all there is. Unix time is boot_time plus monotonic.
+//
+// The layout is ABI: user programs carry a copy (programs/sysinfo.h).
+
+#define SYSINFO_VERSION 1
+
+struct SysInfoPage {
+    volatile uint32_t seq;  // Odd while the kernel rewrites the clock fields
+    uint32_t version;       // SYSINFO_VERSION
+
+    // Clock, as of the last tick
+    uint64_t ticks;         // Timer ticks since boot
+    uint64_t mono_ns;       // Monotonic time, at...
+    uint64_t tsc;           // ...this TSC value
+    uint64_t ns_per_cycle;  // 32.32
+    uint32_t tick_hz;
+    uint32_t boot_time;     // Unix time at monotonic 0, from the RTC
+
+    // System
+    uint32_t cpu_count;     // Online CPUs
+    uint32_t cpu_signature; // CPUID leaf 1 EAX
+    uint32_t cpu_features_edx;
+    uint32_t cpu_features_ecx;
+    uint32_t tsc_khz;       // 0 = no TSC clock
+    char cpu_vendor[16];
+};
+
+class SysInfo {
+public:
+    static void Init();   // After the PMM, Clock and PIT are up
+    static void Update(); // Boot CPU, from the timer IRQ
+    static bool MapInto(); // Active address space (a new process, which fails without it)
+    static uint32_t BootTime() { return page ? page->boot_time : 0; }
+
+private:
+    static SysInfoPage* page;
+};
+#endif
@@ -0,0 +1,139 @@
+#include "timer.h"
+#include "smp.h"
+#include "../utils/spinlock.h"
+#include "../drivers/pit.h"
+#include "../utils/math.h"
+
+#define LEVEL0_SIZE (1u << TIMER_LEVEL0_BITS)
+#define LEVEL_SIZE  (1u << TIMER_LEVEL_BITS)
+#define MAX_DELTA   ((1u << (TIMER_LEVEL0_BITS + (TIMER_LEVELS - 1) * TIMER_LEVEL_BITS)) - 1)
+
+Timer* TimerWheel::slots[TIMER_SLOTS];
+uint32_t TimerWheel::now = 0;
+volatile bool TimerWheel::idle = false;
+uint32_t TimerWheel::idle_deadline = 0;
+static Spinlock wheel_lock;
+
+// Bit position where 'level' starts indexing the expiry tick
+static inline uint32_t LevelShift(int level) {
+    return level ? TIMER_LEVEL0_BITS + (level - 1) * TIMER_LEVEL_BITS : 0;
+}
+
+static inline uint32_t LevelBase(int level) {
+    return level ? LEVEL0_SIZE + (level - 1) * LEVEL_SIZE : 0;
+}
+
+void TimerWheel::Insert(Timer* timer) {
+    uint32_t expires = timer->expires;
+    int32_t delta = (int32_t)(expires - now);
+
+    uint32_t slot;
+    if (delta < 0) {
+        slot = now & (LEVEL0_SIZE - 1); // Already due: next tick
+    } else {
+        if ((uint32_t)delta > MAX_DELTA) expires = now + MAX_DELTA; // Re-filed on cascade
+        int level = 0;
+        while (level < TIMER_LEVELS - 1 && ((uint32_t)delta >> LevelShift(level + 1)) != 0) level++;
+        uint32_t mask = (level ? LEVEL_SIZE : LEVEL0_SIZE) - 1;
+        slot = LevelBase(level) + ((expires >> LevelShift(level)) & mask);
+    }
+
+    timer->slot = slot;
+    timer->prev = 0;
+    timer->next = slots[slot];
+    if (timer->next) timer->next->prev = timer;
+    slots[slot] = timer;
+    timer->pending = true;
+}
+
+void TimerWheel::Unlink(Timer* timer) {
+    if (timer->prev) timer->prev->next = timer->next;
+    else slots[timer->slot] = timer->next;
+    if (timer->next) timer->next->prev = timer->prev;
+    timer->pending = false;
+}
+
+void TimerWheel::AddTicks(Timer* timer, uint32_t ticks, TimerCallback callback, void* arg) {
+    bool kick;
+    {
+        SpinlockGuard guard(wheel_lock);
+        if (timer->pending) Unlink(timer);
+        timer->callback = callback;
+        timer->arg = arg;
+        timer->expires = now + ticks;
+        Insert(timer);
+        // The boot CPU's one-shot would fire too late for it
+        kick = idle && (int32_t)(timer->expires - idle_deadline) < 0;
+    }
+    if (kick) SMP::Kick(0);
+}
+
+void TimerWheel::Add(Timer* timer, uint32_t ms, TimerCallback callback, void* arg) {
+    // Round up: never early
+    uint32_t ticks = (uint32_t)udiv64((uint64_t)ms * PIT::Frequency() + 999, 1000, 0);
+    AddTicks(timer, ticks, callback, arg);
+}
+
+bool TimerWheel::Cancel(Timer* timer) {
+    SpinlockGuard guard(wheel_lock);
+    bool was_pending = timer->pending;
+    if (was_pending) Unlink(timer);
+    return was_pending;
+}
+
+// Re-file level 'level's current slot into the levels below; returns its index
+uint32_t TimerWheel::Cascade(int level) {
+    uint32_t index = (now >> LevelShift(level)) & (LEVEL_SIZE - 1);
+    Timer* list = slots[LevelBase(level) + index];
+    slots[LevelBase(level) + index] = 0;
+    while (list) {
+        Timer* next = list->next;
+        Insert(list);
+        list = next;
+    }
+    return index;
+}
+
+void TimerWheel::Tick() {
+    wheel_lock.Lock(); // IRQ0: interrupts are already off
+    uint32_t slot = now & (LEVEL0_SIZE - 1);
+    // Level 0 wrapped: pull the next span down from above
+    uint32_t index = slot;
+    for (int level = 1; !index && level < TIMER_LEVELS; level++) index = Cascade(level);
+    now++; // Anything added from here on files into later slots
+
+    // One at a time, unlocked while it runs: a callback (or another CPU)
+    // may add or cancel timers, including the ones still in this slot
+    while (Timer* timer = slots[slot]) {
+        Unlink(timer);
+        TimerCallback callback = timer->callback;
+        void* arg = timer->arg;
+        wheel_lock.Unlock();
+        callback(arg);
+        wheel_lock.Lock();
+    }
+    wheel_lock.Unlock();
+}
+
+// The deadline is taken under the same lock AddTicks checks it under, so a
+// timer added on another CPU is either counted here or kicks us. The PIT
+// may arm sooner than asked (its one-shot is short), never later.
+uint32_t TimerWheel::BeginIdle() {
+    SpinlockGuard guard(wheel_lock);
+    uint32_t due = LEVEL0_SIZE;
+    for (uint32_t d = 0; d < LEVEL0_SIZE; d++) {
+        uint32_t index = (now + d) & (LEVEL0_SIZE - 1);
+        // A timer due there, or level 0 wrapping (a cascade may bring some)
+        if (slots[index] || !index) {
+            due = d + 1;
+            break;
+        }
+    }
+    idle_deadline = now + due - 1; // 'now' is the next tick to process
+    idle = true;
+    return due;
+}
+
+void TimerWheel::EndIdle() {
+    idle = false;
+}
@@ -0,0 +1,60 @@
+#ifndef TIMER_H
+#define TIMER_H
+#include <stdint.h>
+
+// Kernel timers on a hierarchical timing wheel, advanced by IRQ0.
+// Level 0 has one slot per tick for the next 256 ticks; each of the three
+// levels above covers 64 times the span of the one below (2^26 ticks, ~18
+// hours at 1000 Hz; longer delays are re-filed when they come round).
+// Add and Cancel are O(1); a timer cascades down at most three times.
+// Any CPU may add and cancel; callbacks run on the boot CPU outside the
+// wheel's lock, so Cancel can miss one that is already running. While the
+// boot CPU idles with its tick stopped, adding a timer due before it would
+// wake sends it an IPI, so it re-arms for the earlier deadline.
+
+#define TIMER_LEVEL0_BITS 8
+#define TIMER_LEVEL_BITS  6
+#define TIMER_LEVELS      4
+#define TIMER_SLOTS       ((1 << TIMER_LEVEL0_BITS) + (TIMER_LEVELS - 1) * (1 << TIMER_LEVEL_BITS))
+
+typedef void (*TimerCallback)(void* arg);
+
+// Embedded in the owner's object; the wheel never allocates.
+struct Timer {
+    uint32_t expires;       // Tick it fires on
+    TimerCallback callback; // Runs from IRQ0 with interrupts off; may re-add itself
+    void* arg;
+    Timer* next;
+    Timer* prev;
+    uint16_t slot;          // List it is on, while pending
+    bool pending;
+};
+
+class TimerWheel {
+public:
+    // Fire 'callback(arg)' after at least 'ms' milliseconds. Adding a pending
+    // timer moves it.
+    static void Add(Timer* timer, uint32_t ms, TimerCallback callback, void* arg);
+    static void AddTicks(Timer* timer, uint32_t ticks, TimerCallback callback, void* arg);
+    static bool Cancel(Timer* timer); // false if it was not pending
+
+    static void Tick(); // IRQ0, once per PIT tick
+    static uint32_t Now() { return now; }
+    // Boot CPU's idle thread, IRQs off. BeginIdle: ticks until the first
+    // one with work to do (1 = the next), at most 256, to sleep that long
+    // with the tick stopped; until EndIdle, timers added for earlier kick
+    // the boot CPU awake.
+    static uint32_t BeginIdle();
+    static void EndIdle();
+
+private:
+    static void Insert(Timer* timer);
+    static void Unlink(Timer* timer);
+    static uint32_t Cascade(int level);
+
+    static Timer* slots[TIMER_SLOTS];
+    static uint32_t now; // Next tick to process
+    static volatile bool idle;      // Boot CPU halted with its tick stopped...
+    static uint32_t idle_deadline;  // ...until no later than this tick
+};
+#endif
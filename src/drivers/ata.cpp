@@ -1,4 +1,7 @@
 #include "ata.h"
+#include "../core/clock.h"
+#include "../utils/memory.h"
+#include "../utils/spinlock.h"
 
 // Ports for Primary Bus
 #define ATA_DATA        0x1F0
@@ -11,7 +14,27 @@
 #define ATA_COMMAND     0x1F7
 #define ATA_STATUS      0x1F7
 
+#define ATA_STATUS_BSY  0x80
+#define ATA_STATUS_DRQ  0x08
+#define ATA_TIMEOUT_US  5000000 // Generous: a drive may have to spin up
+
+// One command on the bus at a time. Held with IRQs on (a transfer can poll
+// for a long while), so never from an IRQ handler.
+static Spinlock bus_lock;
+
+// Poll until the drive is ready to move data; false if it never becomes so
+static bool WaitReady() {
+    uint64_t deadline = Clock::Deadline(ATA_TIMEOUT_US);
+    uint8_t status = InterruptManager::ReadPort(ATA_STATUS);
+    while ((status & ATA_STATUS_BSY) && !(status & ATA_STATUS_DRQ)) {
+        if (Clock::Expired(deadline)) return false;
+        status = InterruptManager::ReadPort(ATA_STATUS);
+    }
+    return true;
+}
+
 void AdvancedTechnologyAttachment::Read28(uint32_t sector, uint8_t* data) {
+    bus_lock.Lock();
     // 1. Select Master Drive + Top 4 bits of LBA
     InterruptManager::WritePort(ATA_DRIVE_HEAD, 0xE0 | ((sector >> 24) & 0x0F));
     
@@ -30,9 +53,10 @@ void AdvancedTechnologyAttachment::Read28(uint32_t sector, uint8_t* data) {
     InterruptManager::WritePort(ATA_COMMAND, 0x20);
 
     // 6. Wait for Ready (Poll Status)
-    uint8_t status = InterruptManager::ReadPort(ATA_STATUS);
-    while ((status & 0x80) && !(status & 0x08)) {
-        status = InterruptManager::ReadPort(ATA_STATUS);
+    if (!WaitReady()) {
+        bus_lock.Unlock();
+        memset(data, 0, 512);
+        return;
     }
 
     // 7. Read Data (256 words = 512 bytes)
@@ -41,9 +65,11 @@ void AdvancedTechnologyAttachment::Read28(uint32_t sector, uint8_t* data) {
         data[i*2] = d & 0xFF;
         data[i*2+1] = (d >> 8) & 0xFF;
     }
+    bus_lock.Unlock();
 }
 
 void AdvancedTechnologyAttachment::Write28(uint32_t sector, uint8_t* data) {
+    bus_lock.Lock();
     InterruptManager::WritePort(ATA_DRIVE_HEAD, 0xE0 | ((sector >> 24) & 0x0F));
     InterruptManager::WritePort(ATA_ERROR, 0x00);
     InterruptManager::WritePort(ATA_SECTOR_CNT, 1);
@@ -54,9 +80,9 @@ void AdvancedTechnologyAttachment::Write28(uint32_t sector, uint8_t* data) {
     // Write Command (0x30)
     InterruptManager::WritePort(ATA_COMMAND, 0x30);
 
-    uint8_t status = InterruptManager::ReadPort(ATA_STATUS);
-    while ((status & 0x80) && !(status & 0x08)) {
-        status = InterruptManager::ReadPort(ATA_STATUS);
+    if (!WaitReady()) {
+        bus_lock.Unlock();
+        return;
     }
 
     for(int i=0; i<256; i++) {
@@ -66,6 +92,7 @@ void AdvancedTechnologyAttachment::Write28(uint32_t sector, uint8_t* data) {
     
     // Cache Flush (0xE7)
     InterruptManager::WritePort(ATA_COMMAND, 0xE7);
+    bus_lock.Unlock();
 }
 
 void AdvancedTechnologyAttachment::Flush() {
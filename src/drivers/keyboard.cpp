@@ -1,13 +1,45 @@
 #include "keyboard.h"
+#include "../core/cpu.h"
+#include "../utils/memory.h"
 
-volatile char Keyboard::lastKey = 0;
+MpscRing<char, KEYBOARD_BUFFER_SIZE> Keyboard::buffer;
+uint32_t Keyboard::dropped = 0;
+WaitQueue Keyboard::readers;
+
+// The key is in before the lock is taken: a reader that found the ring
+// empty under the lock is on the wait queue by the time we get it
+void Keyboard::Push(char c) {
+    if (!buffer.Push(c)) {
+        __sync_fetch_and_add(&dropped, 1);
+        return;
+    }
+    SpinlockGuard guard(readers.lock);
+    readers.WakeAll();
+}
 
 char Keyboard::GetChar() {
-    char c = lastKey;
-    lastKey = 0; // Consumption
+    SpinlockGuard guard(readers.lock);
+    char c = 0;
+    buffer.Pop(c);
     return c;
 }
 
+// Keys come out into a kernel array under the lock and go to 'buf' after
+// it: a user buffer may still have to fault in, which must not happen
+// with the lock held and IRQs off
+uint32_t Keyboard::Read(char* buf, uint32_t max) {
+    char keys[KEYBOARD_READ_CHUNK];
+    if (max > KEYBOARD_READ_CHUNK) max = KEYBOARD_READ_CHUNK;
+    uint32_t n;
+    {
+        SpinlockGuard guard(readers.lock);
+        while (buffer.Empty()) readers.Wait();
+        n = buffer.PopBatch(keys, max);
+    }
+    memcpy(buf, keys, n);
+    return n;
+}
+
 char Keyboard::ScancodeToAscii(uint8_t scancode) {
     // Minimal QWERTY Set
     if (scancode == 0x1E) return 'a';
@@ -1,11 +1,31 @@
 #ifndef KEYBOARD_H
 #define KEYBOARD_H
 #include <stdint.h>
+#include "../core/proc/waitqueue.h"
+#include "../utils/ring.h"
+
+// Keys typed are queued by IRQ1 in a lock-free ring until read; a full
+// ring drops new keys. Readers take keys out under the wait queue's lock
+// (one at a time, as the ring requires) and block on it while the ring is
+// empty; IRQ1 takes the lock only to wake them.
+
+#define KEYBOARD_BUFFER_SIZE 256 // Power of two
+#define KEYBOARD_READ_CHUNK  64  // Most keys one Read() returns
 
 class Keyboard {
 public:
-    static volatile char lastKey;
     static char ScancodeToAscii(uint8_t scancode);
-    static char GetChar();
+
+    static void Push(char c);   // IRQ1
+    static char GetChar();      // Next queued key, 0 if none (never blocks)
+    // Wait until a key is queued, then take up to 'max' (at most
+    // KEYBOARD_READ_CHUNK) at once. Thread context only.
+    static uint32_t Read(char* buf, uint32_t max);
+    static uint32_t Dropped() { return dropped; }
+
+private:
+    static MpscRing<char, KEYBOARD_BUFFER_SIZE> buffer;
+    static uint32_t dropped;
+    static WaitQueue readers;
 };
 #endif
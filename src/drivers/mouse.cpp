@@ -1,22 +1,25 @@
 #include "mouse.h"
 #include "../core/interrupts.h"
+#include "../core/clock.h"
 #include "../core/graphics/console.h"
-#include "../core/gui/desktop.h"
+#include "../core/gui/input.h"
 
 // Helper ports
 #define DATA_PORT 0x60
 #define CMD_PORT 0x64
 
+#define CONTROLLER_TIMEOUT_US 50000 // A missing or wedged controller answers never
+
 void Mouse::WaitWrite() {
-    int timeout = 100000;
-    while (timeout--) {
+    uint64_t deadline = Clock::Deadline(CONTROLLER_TIMEOUT_US);
+    while (!Clock::Expired(deadline)) {
         if ((InterruptManager::ReadPort(CMD_PORT) & 2) == 0) return;
     }
 }
 
 void Mouse::WaitRead() {
-    int timeout = 100000;
-    while (timeout--) {
+    uint64_t deadline = Clock::Deadline(CONTROLLER_TIMEOUT_US);
+    while (!Clock::Expired(deadline)) {
         if ((InterruptManager::ReadPort(CMD_PORT) & 1) == 1) return;
     }
 }
@@ -86,32 +89,10 @@ void Mouse::HandleInterrupt() {
 
         // Decode movement
         int8_t x_rel = (int8_t)packet[1];
-        int8_t y_rel = (int8_t)packet[2];
-        
-        y_rel = -y_rel;
+        int16_t y_rel = -(int8_t)packet[2];
 
-        // Decode Buttons
         // Byte 0: [Y_Ov][X_Ov][Y_S][X_S][1][Mid][Rig][Left]
-        bool left_button = (packet[0] & 1);
-        bool right_button = (packet[0] & 2);
-
-        // Update Position
-        static int mouse_x = 400;
-        static int mouse_y = 300;
-
-        mouse_x += x_rel;
-        mouse_y += y_rel;
-        
-        // Clamp
-        if (mouse_x < 0) mouse_x = 0;
-        if (mouse_y < 0) mouse_y = 0;
-        if (mouse_x >= 799) mouse_x = 799;
-        if (mouse_y >= 599) mouse_y = 599;
-        
-        // Notify Desktop
-        Desktop::OnMouseMove(mouse_x, mouse_y);
-        
-        if (left_button) Desktop::OnMouseDown(1);
-        else Desktop::OnMouseUp(1);
+        // The compositor tracks the pointer and button edges
+        InputQueue::Push(INPUT_MOUSE, 0, packet[0] & 7, x_rel, y_rel);
     }
 }
@@ -0,0 +1,171 @@
+#include "pit.h"
+#include "../core/interrupts.h"
+#include "../utils/spinlock.h"
+#include "../utils/math.h"
+
+#define PIT_CHANNEL0 0x40
+#define PIT_COMMAND  0x43
+#define PIT_MODE0    0x30 // Channel 0, lobyte/hibyte, interrupt on terminal count
+#define PIT_MODE2    0x34 // Channel 0, lobyte/hibyte, rate generator
+#define PIT_LATCH0   0x00 // Latch channel 0's count
+
+// One PIT cycle is 838.0951 ns: integer part plus a 32-bit binary fraction
+#define NS_PER_CLOCK      838
+#define NS_PER_CLOCK_FRAC 408495995u
+
+#define ONESHOT_MAX  65535 // Largest count channel 0 takes
+#define STOP_MARGIN  64    // Cycles left in the period below which the tick is let run
+
+uint32_t PIT::hz = 0;
+uint32_t PIT::reload = 0;
+volatile uint64_t PIT::ticks = 0;
+volatile uint64_t PIT::clocks = 0;
+uint64_t PIT::last_ns = 0;
+bool PIT::stopped = false;
+bool PIT::swallow = false;
+uint32_t PIT::stop_ticks = 0;
+
+// The counter, and the state above: read from every CPU, ticked by the boot CPU
+static Spinlock pit_lock;
+
+static uint64_t ClocksToNs(uint64_t clocks) {
+    return clocks * NS_PER_CLOCK + mul64_frac32(clocks, NS_PER_CLOCK_FRAC);
+}
+
+static void Program(uint8_t mode, uint32_t count) {
+    InterruptManager::WritePort(PIT_COMMAND, mode);
+    InterruptManager::WritePort(PIT_CHANNEL0, count & 0xFF);
+    InterruptManager::WritePort(PIT_CHANNEL0, (count >> 8) & 0xFF);
+}
+
+static uint32_t ReadCount() {
+    InterruptManager::WritePort(PIT_COMMAND, PIT_LATCH0);
+    uint32_t count = InterruptManager::ReadPort(PIT_CHANNEL0);
+    count |= InterruptManager::ReadPort(PIT_CHANNEL0) << 8;
+    return count;
+}
+
+// IRQ0 raised but not yet serviced (we hold IF=0). Through the I/O APIC
+// only the boot CPU can tell; elsewhere Nanoseconds() may briefly lag a
+// tick, which its monotonic clamp absorbs.
+static bool TickPending() {
+    return InterruptManager::IrqPending(0);
+}
+
+void PIT::Init(uint32_t rate) {
+    uint32_t divisor = PIT_INPUT_HZ / rate;
+    if (divisor < 1) divisor = 1;
+    if (divisor > 65536) divisor = 65536; // Written as 0
+
+    reload = divisor;
+    hz = PIT_INPUT_HZ / divisor;
+
+    Program(PIT_MODE2, divisor);
+}
+
+uint32_t PIT::HandleInterrupt() {
+    SpinlockGuard guard(pit_lock);
+    if (stopped) return Resume(true);
+    if (swallow) {
+        swallow = false;
+        return 0;
+    }
+    ticks = ticks + 1;
+    clocks = clocks + reload;
+    return 1;
+}
+
+bool PIT::StopTick(uint32_t n) {
+    if (n > ONESHOT_MAX / reload) n = ONESHOT_MAX / reload;
+    SpinlockGuard guard(pit_lock);
+    if (n < 2 || stopped || TickPending()) return false;
+
+    // Fire on the n-th tick boundary from the start of this period: what
+    // is left of it, plus n-1 whole periods
+    uint32_t count = ReadCount();
+    if (count == 0) count = 65536;
+    if (count < STOP_MARGIN) return false; // About to wrap anyway
+
+    Program(PIT_MODE0, count + (n - 1) * reload);
+    stop_ticks = n;
+    stopped = true;
+    return true;
+}
+
+uint32_t PIT::RestartTick() {
+    SpinlockGuard guard(pit_lock);
+    return stopped ? Resume(false) : 0;
+}
+
+// Leave the one-shot: credit whole periods, and start the next one now.
+// 'fired' = called from the one-shot's own IRQ0.
+uint32_t PIT::Resume(bool fired) {
+    uint64_t end = clocks + (uint64_t)stop_ticks * reload;
+    uint32_t count = ReadCount();
+
+    uint32_t n;
+    uint64_t now;
+    if (fired || TickPending()) {
+        // Expired: past terminal count the counter wraps, so trust the IRQ
+        n = stop_ticks;
+        now = end;
+    } else {
+        uint32_t elapsed = stop_ticks * reload - count;
+        n = elapsed / reload;
+        now = clocks + elapsed;
+    }
+
+    Program(PIT_MODE2, reload);
+    // An expired one-shot still pending, or the edge OUT makes on the mode
+    // change: either way that IRQ0 was just accounted for
+    swallow = !fired && TickPending();
+
+    stopped = false;
+    ticks = ticks + n;
+    clocks = now;
+    return n;
+}
+
+uint64_t PIT::Ticks() {
+    SpinlockGuard guard(pit_lock);
+    return ticks;
+}
+
+uint64_t PIT::Nanoseconds() {
+    SpinlockGuard guard(pit_lock);
+
+    uint32_t count = ReadCount();
+    uint64_t now;
+    if (stopped) {
+        // Counting down to the end of the one-shot
+        uint64_t end = clocks + (uint64_t)stop_ticks * reload;
+        now = TickPending() ? end : end - count;
+    } else {
+        if (count == 0) count = 65536;
+        uint64_t base = clocks;
+        // The counter wrapped but IRQ0 is still pending: the tick hasn't
+        // been counted yet. A high count means it was latched after the
+        // wrap; a low one, just before it.
+        if (TickPending() && !swallow && count > reload / 2) base += reload;
+        now = base + (reload - count);
+    }
+
+    uint64_t ns = ClocksToNs(now);
+    if (ns < last_ns) ns = last_ns;
+    last_ns = ns;
+    return ns;
+}
+
+uint32_t PIT::UptimeSeconds() {
+    uint64_t c;
+    {
+        SpinlockGuard guard(pit_lock);
+        c = clocks;
+    }
+    return (uint32_t)udiv64(c, PIT_INPUT_HZ, 0);
+}
+
+void PIT::Sleep(uint32_t ms) {
+    uint64_t until = Nanoseconds() + (uint64_t)ms * 1000000;
+    while (Nanoseconds() < until) asm volatile("hlt");
+}
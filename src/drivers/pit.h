@@ -0,0 +1,49 @@
+#ifndef PIT_H
+#define PIT_H
+#include <stdint.h>
+
+// Programmable Interval Timer (8253/8254), channel 0 on IRQ0.
+// Provides the system tick and a monotonic clock since boot. Between ticks
+// the clock interpolates from the channel's down-counter, so Nanoseconds()
+// resolves to one PIT input cycle (~838 ns) rather than one tick.
+//
+// Tickless idle: with nothing to run, the idle thread swaps the periodic
+// tick for a one-shot at the next timer deadline (at most 65535 input
+// cycles, ~55 ms, away). Whichever interrupt ends the halt, the elapsed
+// ticks are then credited in one go and the periodic tick resumes.
+
+#define PIT_INPUT_HZ   1193182
+#define PIT_DEFAULT_HZ 1000
+
+class PIT {
+public:
+    static void Init(uint32_t hz); // Tick rate, 19..1193182 Hz (rounded to the divisor)
+    static uint32_t HandleInterrupt(); // IRQ0; returns the ticks that elapsed (0 or more)
+
+    static uint32_t Frequency() { return hz; }
+    static uint64_t Ticks();
+    static uint64_t Nanoseconds();  // Monotonic, since Init
+    static uint32_t UptimeSeconds();
+
+    // Spin (with HLT between ticks) for at least 'ms' milliseconds. Needs IRQs on.
+    static void Sleep(uint32_t ms);
+
+    // Idle thread only, IRQs off. StopTick: fire once after up to 'ticks'
+    // ticks instead of every tick (false if that is not worth it).
+    // RestartTick: back to periodic; returns the ticks that passed.
+    static bool StopTick(uint32_t ticks);
+    static uint32_t RestartTick();
+
+private:
+    static uint32_t hz;
+    static uint32_t reload;         // Divisor loaded into channel 0
+    static volatile uint64_t ticks;
+    static volatile uint64_t clocks; // PIT input cycles elapsed at the last tick
+    static uint64_t last_ns;        // Keeps interpolated readings monotonic
+
+    static uint32_t Resume(bool fired);
+    static bool stopped;            // Channel 0 is in a tickless one-shot
+    static bool swallow;            // Next IRQ0 was already accounted for
+    static uint32_t stop_ticks;     // Ticks the one-shot covers, from 'clocks'
+};
+#endif
@@ -1,9 +1,16 @@
 #include "rtc.h"
 #include "../core/interrupts.h"
 
-uint8_t RTC::Read(uint8_t reg) {
+#define RTC_STATUS_A 0x0A
+#define RTC_UPDATING 0x80 // Status A: the registers are being rewritten
+
+static uint8_t ReadRaw(uint8_t reg) {
     InterruptManager::WritePort(0x70, reg);
-    uint8_t val = InterruptManager::ReadPort(0x71);
+    return InterruptManager::ReadPort(0x71);
+}
+
+uint8_t RTC::Read(uint8_t reg) {
+    uint8_t val = ReadRaw(reg);
     // Convert BCD to Binary
     return (val & 0x0F) + ((val / 16) * 10);
 }
@@ -11,3 +18,33 @@ uint8_t RTC::Read(uint8_t reg) {
 uint8_t RTC::GetSecond() { return Read(0x00); }
 uint8_t RTC::GetMinute() { return Read(0x02); }
 uint8_t RTC::GetHour()   { return Read(0x04); }
+uint8_t RTC::GetDay()    { return Read(0x07); }
+uint8_t RTC::GetMonth()  { return Read(0x08); }
+uint8_t RTC::GetYear()   { return Read(0x09); }
+
+// Days from 1970-01-01 to y-m-d (proleptic Gregorian, March-based years)
+static uint32_t DaysFromCivil(uint32_t y, uint32_t m, uint32_t d) {
+    if (m <= 2) y--;
+    uint32_t era = y / 400;
+    uint32_t yoe = y - era * 400;
+    uint32_t doy = (153 * (m > 2 ? m - 3 : m + 9) + 2) / 5 + d - 1;
+    uint32_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + doe - 719468;
+}
+
+uint32_t RTC::UnixTime() {
+    // The same reading twice, outside an update, is a consistent one
+    uint8_t t[6], prev[6];
+    bool same = false;
+    for (int tries = 0; tries < 8 && !same; tries++) {
+        for (int i = 0; i < 6; i++) prev[i] = t[i];
+        while (ReadRaw(RTC_STATUS_A) & RTC_UPDATING) asm volatile("pause");
+        t[0] = GetSecond(); t[1] = GetMinute(); t[2] = GetHour();
+        t[3] = GetDay(); t[4] = GetMonth(); t[5] = GetYear();
+        same = tries > 0;
+        for (int i = 0; i < 6; i++) if (t[i] != prev[i]) same = false;
+    }
+
+    uint32_t days = DaysFromCivil(2000 + t[5], t[4], t[3]);
+    return days * 86400 + t[2] * 3600 + t[1] * 60 + t[0];
+}
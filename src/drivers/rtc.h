@@ -7,6 +7,13 @@ public:
     static uint8_t GetSecond();
     static uint8_t GetMinute();
     static uint8_t GetHour();
+    static uint8_t GetDay();
+    static uint8_t GetMonth();
+    static uint8_t GetYear(); // Two digits: 2000 + this
+
+    // Seconds since 1970-01-01 00:00 (the RTC is taken to keep UTC).
+    // Waits out an update in progress: ms, so not for hot paths.
+    static uint32_t UnixTime();
 
 private:
     static uint8_t Read(uint8_t reg);
@@ -1,13 +1,24 @@
 #include "core/mm/kheap.h"
+#include "core/mm/pmm.h"
+#include "core/cpu.h"
+#include "core/fpu.h"
+#include "core/clock.h"
 #include "core/gdt.h"
 #include "core/interrupts.h"
+#include "core/syscall.h"
+#include "core/sysinfo.h"
+#include "core/smp.h"
+#include "core/acpi.h"
 #include "drivers/mouse.h"
+#include "drivers/pit.h"
 #include "core/paging.h"
 #include "core/graphics/console.h"
 #include "core/gui/desktop.h"
 #include "core/gui/window.h"
-#include "core/fs/sfs.h"
 #include "core/fs/ext4.h"
+#include "core/proc/process.h"
+#include "core/proc/scheduler.h"
+#include "utils/memory.h"
 
 struct MultibootInfo {
     uint32_t flags;
@@ -42,18 +53,69 @@ struct MultibootInfo {
     uint8_t framebuffer_type;
 };
 
-// Global mapping helper (from paging.cpp)
-extern "C" void MapMemory(uint32_t virt, uint32_t phys);
+struct MultibootModule {
+    uint32_t mod_start;
+    uint32_t mod_end;
+    uint32_t string;
+    uint32_t reserved;
+};
+
+#define MULTIBOOT_FLAG_MODS 0x08
+#define MULTIBOOT_FLAG_MMAP 0x40
+
+#define KERNEL_HEAP_SIZE 0x00A00000 // 10MB (Enough for windows & buffers)
+#define KERNEL_HEAP_MIN  0x00400000 // Back buffer and then some: below this, don't boot
+
+// End of the kernel image (linker.ld)
+extern "C" uint8_t kernel_end[];
+
+// Before the console exists: straight into VGA text memory, then stop
+static void BootPanic(const char* msg) {
+    uint16_t* vid = (uint16_t*)0xB8000;
+    for (int i = 0; msg[i]; i++) vid[i] = 0x4F00 | (uint8_t)msg[i];
+    while (1) asm volatile("cli; hlt");
+}
 
 extern "C" void kernel_main(uint32_t magic, void* multiboot_ptr) {
-    // 1. Init Core
-    kheap_init(0x00A00000, 0x00A00000); // 10MB (Enough for windows & buffers)
+    MultibootInfo* mbi = (MultibootInfo*)multiboot_ptr;
+    CPU::Init();
+    FPU::Init();
+    memory_init(); // Bind memcpy/memset to the best kernels for this CPU
+    Clock::Init(); // Calibrate the TSC against the PIT (needs no IRQs)
+
+    // 1. Physical Memory: free RAM from the bootloader map, minus what's in use
+    if (mbi->flags & MULTIBOOT_FLAG_MMAP) pmm_init(mbi->mmap_addr, mbi->mmap_length, mbi->mem_upper);
+    else pmm_init(0, 0, mbi->mem_upper);
+
+    pmm_reserve(0x100000, (uint32_t)kernel_end - 0x100000);
+    pmm_reserve((uint32_t)mbi, sizeof(MultibootInfo));
+    if (mbi->flags & MULTIBOOT_FLAG_MMAP) pmm_reserve(mbi->mmap_addr, mbi->mmap_length);
+    if (mbi->flags & MULTIBOOT_FLAG_MODS) {
+        MultibootModule* mods = (MultibootModule*)mbi->mods_addr;
+        pmm_reserve(mbi->mods_addr, mbi->mods_count * sizeof(MultibootModule));
+        for (uint32_t i = 0; i < mbi->mods_count; i++)
+            pmm_reserve(mods[i].mod_start, mods[i].mod_end - mods[i].mod_start);
+    }
+
+    // Physical RAM behind the user image window is shadowed in every
+    // process, so no kernel data may live there
+    pmm_reserve(USER_IMAGE_BASE, USER_IMAGE_END - USER_IMAGE_BASE);
+
+    // 2. Init Core
+    // Smaller if RAM is short (or too fragmented for 10MB in one piece)
+    uint32_t heap_size = KERNEL_HEAP_SIZE;
+    uint32_t heap_base = 0;
+    while (heap_size >= KERNEL_HEAP_MIN && !(heap_base = pmm_alloc_frames(heap_size / PMM_FRAME_SIZE)))
+        heap_size /= 2;
+    if (!heap_base) BootPanic("PANIC: NO MEMORY FOR THE KERNEL HEAP");
+    kheap_init(heap_base, heap_size);
     GlobalDescriptorTable gdt;
     InterruptManager interrupts(&gdt);
     PageTableManager::Init(); 
+    ProcessManager::Init(&gdt);
+    Syscall::Init(&gdt); // int 0x80, plus SYSENTER where the CPU has it
 
-    // 2. Get Graphics Info
-    MultibootInfo* mbi = (MultibootInfo*)multiboot_ptr;
+    // 3. Get Graphics Info
     
     // NOTE: cast to uint32_t for 32-bit systems
     uint32_t fb_phys = (uint32_t)mbi->framebuffer_addr; 
@@ -61,16 +123,17 @@ extern "C" void kernel_main(uint32_t magic, void* multiboot_ptr) {
     uint32_t height = mbi->framebuffer_height;
     uint32_t pitch = mbi->framebuffer_pitch;
     
-    // 3. Map Framebuffer (Crucial!)
+    // 4. Map Framebuffer (Crucial!)
     // Framebuffer is large (e.g. 800*600*4 = ~2MB).
-    // We map it 1:1 (Virt = Phys) for simplicity.
-    // We need to map enough pages to cover the whole screen.
+    // We map it 1:1 (Virt = Phys) for simplicity, kernel-only and global.
+    // VRAM BARs are at least 4MB (QEMU/Bochs VGA: 16MB), so an aligned
+    // framebuffer is rounded up to whole 4MB pages: one TLB entry per 4MB.
     uint32_t fb_size = height * pitch;
-    for (uint32_t offset = 0; offset < fb_size; offset += 4096) {
-        MapMemory(fb_phys + offset, fb_phys + offset);
-    }
+    if (PageTableManager::LargePagesEnabled() && (fb_phys & (LARGE_PAGE_SIZE - 1)) == 0)
+        fb_size = (fb_size + LARGE_PAGE_SIZE - 1) & ~(LARGE_PAGE_SIZE - 1);
+    PageTableManager::MapRange(fb_phys, fb_phys, fb_size, PAGE_WRITE | PAGE_GLOBAL, "framebuffer");
 
-    // 4. Init Console (Replaces Gradient Test)
+    // 5. Init Console (Replaces Gradient Test)
     Console::Init((uint32_t*)fb_phys, width, height);
     
     // Init Serial Port (COM1)
@@ -88,16 +151,44 @@ extern "C" void kernel_main(uint32_t magic, void* multiboot_ptr) {
     Console::Print("Loading Modules...\n");
     
     Mouse::Init();
+    PIT::Init(PIT_DEFAULT_HZ);
+    SysInfo::Init(); // Before the first process: each one maps it
+    Scheduler::Init(&gdt); // kernel_main carries on as the idle thread
     
     // Init Filesystem
     // SimpleFileSystem::Init();
     Ext4::Init();
     
-    // Init Desktop
+    // Start user programs (GRUB modules, ELF executables), each in its own
+    // address space; the first is init
+    if (mbi->flags & MULTIBOOT_FLAG_MODS) {
+        MultibootModule* mods = (MultibootModule*)mbi->mods_addr;
+        for (uint32_t i = 0; i < mbi->mods_count; i++) {
+            const char* name = i == 0 ? "init" : "module";
+            Process* p = ProcessManager::Create(name, (const uint8_t*)mods[i].mod_start, mods[i].mod_end - mods[i].mod_start);
+            if (!p) {
+                Console::Print("Not a runnable ELF module: ");
+                Console::Print(name);
+                Console::Print("\n");
+            } else if (!Scheduler::StartProcess(p)) {
+                ProcessManager::Destroy(p);
+            }
+        }
+    }
+
+    // Init Desktop; its thread repaints as the IRQs queue input
     Desktop::Init();
+    Scheduler::Spawn("compositor", Desktop::Run, 0);
 
-    // 5. Run Systems (We won't see text, but keyboard works)
+    // 6. Run Systems (We won't see text, but keyboard works)
     interrupts.Activate();
 
-    while(1);
+    // Device IRQs through the I/O APIC, where ACPI describes one
+    if (ACPI::Init()) InterruptManager::EnableIOAPIC();
+
+    // Wake the other CPUs; each joins the scheduler as it comes up.
+    // (The trampoline page is in the low 1MB the PMM never hands out.)
+    SMP::Init(&gdt);
+
+    Scheduler::Idle();
 }
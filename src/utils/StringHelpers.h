@@ -2,6 +2,7 @@
 #define STRING_HELPERS_H
 
 #include "../core/mm/kheap.h"
+#include "memory.h"
 
 namespace Utils {
     static int strlen(const char* str) {
@@ -9,16 +10,13 @@ namespace Utils {
     }
 
     static void strcpy(char* dest, const char* src) {
-        while(*src) *dest++ = *src++;
-        *dest = 0;
+        memcpy(dest, src, strlen(src) + 1);
     }
 
     static void strncpy(char* dest, const char* src, int n) {
         int i=0;
-        while(src[i] && i < n) {
-            dest[i] = src[i];
-            i++;
-        }
+        while(src[i] && i < n) i++;
+        memcpy(dest, src, i);
         dest[i] = 0;
     }
 
@@ -44,9 +42,36 @@ namespace Utils {
     }
 
     static void strcat(char* dest, const char* src) {
-        while(*dest) dest++;
-        while(*src) *dest++ = *src++;
-        *dest = 0;
+        strcpy(dest + strlen(dest), src);
+    }
+
+    // Unsigned to decimal string. Returns length written (excl. terminator).
+    static int utoa(uint32_t value, char* out) {
+        char tmp[11];
+        int n = 0;
+        do { tmp[n++] = '0' + (value % 10); value /= 10; } while (value);
+        for (int i = 0; i < n; i++) out[i] = tmp[n - 1 - i];
+        out[n] = 0;
+        return n;
+    }
+
+    // Decimal string to unsigned. false if empty or not all digits.
+    static bool atou(const char* s, uint32_t* out) {
+        uint32_t v = 0;
+        if (!*s) return false;
+        for (; *s; s++) {
+            if (*s < '0' || *s > '9') return false;
+            v = v * 10 + (*s - '0');
+        }
+        *out = v;
+        return true;
+    }
+
+    // 32-bit value as 8 uppercase hex digits (no prefix).
+    static void xtoa(uint32_t value, char* out) {
+        const char* digits = "0123456789ABCDEF";
+        for (int i = 0; i < 8; i++) out[i] = digits[(value >> ((7 - i) * 4)) & 0xF];
+        out[8] = 0;
     }
 
     // Helper to extract filename from path
@@ -0,0 +1,23 @@
+#ifndef MATH_H
+#define MATH_H
+#include <stdint.h>
+
+// 64-bit helpers that stay clear of libgcc (__udivdi3 is not linked in).
+
+// n / d with a 32-bit divisor: two chained DIVs, each of which fits.
+static inline uint64_t udiv64(uint64_t n, uint32_t d, uint32_t* rem) {
+    uint32_t hi = (uint32_t)(n >> 32), lo = (uint32_t)n;
+    uint32_t q_hi = hi / d;
+    uint32_t q_lo, r;
+    asm("divl %4" : "=a"(q_lo), "=d"(r) : "a"(lo), "d"(hi % d), "rm"(d));
+    if (rem) *rem = r;
+    return ((uint64_t)q_hi << 32) | q_lo;
+}
+
+// (a * b) >> 32 for a 64-bit a, without losing the high half of the product.
+static inline uint64_t mul64_frac32(uint64_t a, uint32_t b) {
+    uint64_t hi = (a >> 32) * b;
+    uint64_t lo = ((a & 0xFFFFFFFF) * b) >> 32;
+    return hi + lo;
+}
+#endif
@@ -0,0 +1,304 @@
+#include "memory.h"
+#include "../core/cpu.h"
+#include "../core/fpu.h"
+
+// Below this, saving FPU state and masking IRQs costs more than wide stores win
+#define VECTOR_THRESHOLD 512
+#define MIN_VECTOR_ROW   64
+// Most work per FPU bracket: IRQs are off inside one, so a large copy
+// re-opens them between chunks (~64KB is a few microseconds)
+#define VECTOR_CHUNK     65536
+
+// Lets the asm name XMM/YMM registers; the rest of the kernel stays -mno-sse
+#define SSE2_FN __attribute__((target("sse2")))
+#define AVX_FN  __attribute__((target("avx")))
+
+typedef void (*CopyFn)(uint8_t* dst, const uint8_t* src, size_t n);
+typedef void (*FillFn)(uint8_t* dst, uint32_t pattern, size_t n);
+
+// Byte of a repeating 32-bit pattern that belongs at 'at', so pixel fills
+// stay in phase however the unaligned head is split off.
+static inline uint8_t PatternByte(uint32_t pattern, const uint8_t* at) {
+    return (uint8_t)(pattern >> (((uint32_t)at & 3) * 8));
+}
+
+static inline size_t HeadBytes(const uint8_t* dst, uint32_t align, size_t n) {
+    size_t head = (align - ((uint32_t)dst & (align - 1))) & (align - 1);
+    return head < n ? head : n;
+}
+
+// --- String Instructions (no FPU state) ---
+static void CopyMovsd(uint8_t* dst, const uint8_t* src, size_t n) {
+    size_t dwords = n / 4, bytes = n & 3;
+    asm volatile("cld; rep movsl" : "+D"(dst), "+S"(src), "+c"(dwords) : : "memory");
+    asm volatile("rep movsb" : "+D"(dst), "+S"(src), "+c"(bytes) : : "memory");
+}
+
+static void CopyErms(uint8_t* dst, const uint8_t* src, size_t n) {
+    asm volatile("cld; rep movsb" : "+D"(dst), "+S"(src), "+c"(n) : : "memory");
+}
+
+static void FillStosd(uint8_t* dst, uint32_t pattern, size_t n) {
+    while (n && ((uint32_t)dst & 3)) { *dst = PatternByte(pattern, dst); dst++; n--; }
+    size_t dwords = n / 4;
+    asm volatile("cld; rep stosl" : "+D"(dst), "+c"(dwords) : "a"(pattern) : "memory");
+    for (n &= 3; n; n--, dst++) *dst = PatternByte(pattern, dst);
+}
+
+// --- SSE2: 64 bytes per iteration, destination 16-byte aligned ---
+SSE2_FN static void CopySse2Blocks(uint8_t* dst, const uint8_t* src, size_t n, bool stream) {
+    size_t head = HeadBytes(dst, 16, n);
+    CopyMovsd(dst, src, head);
+    dst += head; src += head; n -= head;
+
+    size_t blocks = n / 64;
+    if (blocks && stream) {
+        asm volatile(
+            "1:\n"
+            "movdqu (%1), %%xmm0\n"
+            "movdqu 16(%1), %%xmm1\n"
+            "movdqu 32(%1), %%xmm2\n"
+            "movdqu 48(%1), %%xmm3\n"
+            "movntdq %%xmm0, (%0)\n"
+            "movntdq %%xmm1, 16(%0)\n"
+            "movntdq %%xmm2, 32(%0)\n"
+            "movntdq %%xmm3, 48(%0)\n"
+            "add $64, %1\n"
+            "add $64, %0\n"
+            "dec %2\n"
+            "jnz 1b\n"
+            "sfence\n"
+            : "+r"(dst), "+r"(src), "+r"(blocks) : : "xmm0", "xmm1", "xmm2", "xmm3", "memory", "cc");
+    } else if (blocks) {
+        asm volatile(
+            "1:\n"
+            "movdqu (%1), %%xmm0\n"
+            "movdqu 16(%1), %%xmm1\n"
+            "movdqu 32(%1), %%xmm2\n"
+            "movdqu 48(%1), %%xmm3\n"
+            "movdqa %%xmm0, (%0)\n"
+            "movdqa %%xmm1, 16(%0)\n"
+            "movdqa %%xmm2, 32(%0)\n"
+            "movdqa %%xmm3, 48(%0)\n"
+            "add $64, %1\n"
+            "add $64, %0\n"
+            "dec %2\n"
+            "jnz 1b\n"
+            : "+r"(dst), "+r"(src), "+r"(blocks) : : "xmm0", "xmm1", "xmm2", "xmm3", "memory", "cc");
+    }
+
+    CopyMovsd(dst, src, n & 63);
+}
+
+static void CopySse2(uint8_t* dst, const uint8_t* src, size_t n) { CopySse2Blocks(dst, src, n, false); }
+static void StreamSse2(uint8_t* dst, const uint8_t* src, size_t n) { CopySse2Blocks(dst, src, n, true); }
+
+SSE2_FN static void FillSse2(uint8_t* dst, uint32_t pattern, size_t n) {
+    size_t head = HeadBytes(dst, 16, n);
+    FillStosd(dst, pattern, head);
+    dst += head; n -= head;
+
+    size_t blocks = n / 64;
+    if (blocks) {
+        asm volatile(
+            "movd %2, %%xmm0\n"
+            "pshufd $0, %%xmm0, %%xmm0\n"
+            "1:\n"
+            "movdqa %%xmm0, (%0)\n"
+            "movdqa %%xmm0, 16(%0)\n"
+            "movdqa %%xmm0, 32(%0)\n"
+            "movdqa %%xmm0, 48(%0)\n"
+            "add $64, %0\n"
+            "dec %1\n"
+            "jnz 1b\n"
+            : "+r"(dst), "+r"(blocks) : "r"(pattern) : "xmm0", "memory", "cc");
+    }
+
+    FillStosd(dst, pattern, n & 63);
+}
+
+// --- AVX: 128 bytes per iteration, destination 32-byte aligned ---
+AVX_FN static void CopyAvxBlocks(uint8_t* dst, const uint8_t* src, size_t n, bool stream) {
+    size_t head = HeadBytes(dst, 32, n);
+    CopyMovsd(dst, src, head);
+    dst += head; src += head; n -= head;
+
+    size_t blocks = n / 128;
+    if (blocks && stream) {
+        asm volatile(
+            "1:\n"
+            "vmovdqu (%1), %%ymm0\n"
+            "vmovdqu 32(%1), %%ymm1\n"
+            "vmovdqu 64(%1), %%ymm2\n"
+            "vmovdqu 96(%1), %%ymm3\n"
+            "vmovntdq %%ymm0, (%0)\n"
+            "vmovntdq %%ymm1, 32(%0)\n"
+            "vmovntdq %%ymm2, 64(%0)\n"
+            "vmovntdq %%ymm3, 96(%0)\n"
+            "add $128, %1\n"
+            "add $128, %0\n"
+            "dec %2\n"
+            "jnz 1b\n"
+            "sfence\n"
+            "vzeroupper\n"
+            : "+r"(dst), "+r"(src), "+r"(blocks) : : "xmm0", "xmm1", "xmm2", "xmm3", "memory", "cc");
+    } else if (blocks) {
+        asm volatile(
+            "1:\n"
+            "vmovdqu (%1), %%ymm0\n"
+            "vmovdqu 32(%1), %%ymm1\n"
+            "vmovdqu 64(%1), %%ymm2\n"
+            "vmovdqu 96(%1), %%ymm3\n"
+            "vmovdqa %%ymm0, (%0)\n"
+            "vmovdqa %%ymm1, 32(%0)\n"
+            "vmovdqa %%ymm2, 64(%0)\n"
+            "vmovdqa %%ymm3, 96(%0)\n"
+            "add $128, %1\n"
+            "add $128, %0\n"
+            "dec %2\n"
+            "jnz 1b\n"
+            "vzeroupper\n"
+            : "+r"(dst), "+r"(src), "+r"(blocks) : : "xmm0", "xmm1", "xmm2", "xmm3", "memory", "cc");
+    }
+
+    CopyMovsd(dst, src, n & 127);
+}
+
+static void CopyAvx(uint8_t* dst, const uint8_t* src, size_t n) { CopyAvxBlocks(dst, src, n, false); }
+static void StreamAvx(uint8_t* dst, const uint8_t* src, size_t n) { CopyAvxBlocks(dst, src, n, true); }
+
+AVX_FN static void FillAvx(uint8_t* dst, uint32_t pattern, size_t n) {
+    size_t head = HeadBytes(dst, 32, n);
+    FillStosd(dst, pattern, head);
+    dst += head; n -= head;
+
+    size_t blocks = n / 128;
+    if (blocks) {
+        asm volatile(
+            "vbroadcastss %2, %%ymm0\n"
+            "1:\n"
+            "vmovdqa %%ymm0, (%0)\n"
+            "vmovdqa %%ymm0, 32(%0)\n"
+            "vmovdqa %%ymm0, 64(%0)\n"
+            "vmovdqa %%ymm0, 96(%0)\n"
+            "add $128, %0\n"
+            "dec %1\n"
+            "jnz 1b\n"
+            "vzeroupper\n"
+            : "+r"(dst), "+r"(blocks) : "m"(pattern) : "xmm0", "memory", "cc");
+    }
+
+    FillStosd(dst, pattern, n & 127);
+}
+
+// --- Dispatch ---
+static CopyFn copy_small = CopyMovsd;
+static CopyFn copy_large = 0;   // Vector kernels: only inside FPU::KernelBegin/End
+static CopyFn stream_large = 0;
+static FillFn fill_large = 0;
+static const char* impl_name = "rep movsd";
+
+void memory_init() {
+    bool erms = CPU::HasExtended(CPU::FEATURE7_ERMS);
+    if (erms) copy_small = CopyErms;
+
+    if (FPU::HasAVX()) {
+        copy_large = CopyAvx;
+        stream_large = StreamAvx;
+        fill_large = FillAvx;
+        impl_name = erms ? "erms + avx" : "rep movsd + avx";
+    } else if (FPU::HasSSE2()) {
+        copy_large = CopySse2;
+        stream_large = StreamSse2;
+        fill_large = FillSse2;
+        impl_name = erms ? "erms + sse2" : "rep movsd + sse2";
+    } else {
+        impl_name = erms ? "erms" : "rep movsd";
+    }
+}
+
+const char* memory_impl_name() { return impl_name; }
+
+static void Copy(CopyFn large, uint8_t* dst, const uint8_t* src, size_t n) {
+    if (large && n >= VECTOR_THRESHOLD) {
+        while (n) {
+            size_t chunk = n < VECTOR_CHUNK ? n : VECTOR_CHUNK;
+            uint32_t flags = FPU::KernelBegin();
+            large(dst, src, chunk);
+            FPU::KernelEnd(flags);
+            dst += chunk; src += chunk; n -= chunk;
+        }
+    } else {
+        copy_small(dst, src, n);
+    }
+}
+
+static void Fill(uint8_t* dst, uint32_t pattern, size_t n) {
+    if (fill_large && n >= VECTOR_THRESHOLD) {
+        while (n) {
+            size_t chunk = n < VECTOR_CHUNK ? n : VECTOR_CHUNK;
+            uint32_t flags = FPU::KernelBegin();
+            fill_large(dst, pattern, chunk);
+            FPU::KernelEnd(flags);
+            dst += chunk; n -= chunk;
+        }
+    } else {
+        FillStosd(dst, pattern, n);
+    }
+}
+
+extern "C" void* memcpy(void* dst, const void* src, size_t n) {
+    Copy(copy_large, (uint8_t*)dst, (const uint8_t*)src, n);
+    return dst;
+}
+
+extern "C" void* memset(void* dst, int value, size_t n) {
+    Fill((uint8_t*)dst, (uint8_t)value * 0x01010101u, n);
+    return dst;
+}
+
+void memset32(uint32_t* dst, uint32_t value, size_t count) {
+    Fill((uint8_t*)dst, value, count * 4);
+}
+
+void memcpy_nt(void* dst, const void* src, size_t n) {
+    Copy(stream_large, (uint8_t*)dst, (const uint8_t*)src, n);
+}
+
+// Rows of 'row' bytes that fit one FPU bracket (at least one)
+static inline uint32_t ChunkRows(size_t row) {
+    return row >= VECTOR_CHUNK ? 1 : VECTOR_CHUNK / row;
+}
+
+void fill_rect32(uint32_t* dst, uint32_t pitch, uint32_t width, uint32_t height, uint32_t value) {
+    size_t row = width * 4;
+    // One FPU bracket per VECTOR_CHUNK of rows; narrow spans (borders) stay scalar
+    if (fill_large && row >= MIN_VECTOR_ROW && row * height >= VECTOR_THRESHOLD) {
+        uint32_t rows = ChunkRows(row);
+        for (uint32_t y = 0; y < height;) {
+            uint32_t flags = FPU::KernelBegin();
+            for (uint32_t end = y + rows; y < height && y < end; y++, dst += pitch)
+                fill_large((uint8_t*)dst, value, row);
+            FPU::KernelEnd(flags);
+        }
+        return;
+    }
+    for (uint32_t y = 0; y < height; y++, dst += pitch) FillStosd((uint8_t*)dst, value, row);
+}
+
+void blit32(uint32_t* dst, uint32_t dst_pitch, const uint32_t* src, uint32_t src_pitch,
+            uint32_t width, uint32_t height) {
+    size_t row = width * 4;
+    if (copy_large && row >= MIN_VECTOR_ROW && row * height >= VECTOR_THRESHOLD) {
+        uint32_t rows = ChunkRows(row);
+        for (uint32_t y = 0; y < height;) {
+            uint32_t flags = FPU::KernelBegin();
+            for (uint32_t end = y + rows; y < height && y < end; y++, dst += dst_pitch, src += src_pitch)
+                copy_large((uint8_t*)dst, (const uint8_t*)src, row);
+            FPU::KernelEnd(flags);
+        }
+        return;
+    }
+    for (uint32_t y = 0; y < height; y++, dst += dst_pitch, src += src_pitch)
+        copy_small((uint8_t*)dst, (const uint8_t*)src, row);
+}
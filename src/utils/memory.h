@@ -0,0 +1,28 @@
+#ifndef MEMORY_H
+#define MEMORY_H
+#include <stddef.h>
+#include <stdint.h>
+
+// Memory primitives with runtime dispatch.
+// memory_init() probes CPUID once at boot and binds the fastest kernels
+// for this machine: "rep movsd", ERMS "rep movsb", SSE2 or AVX. Vector
+// kernels only kick in for large blocks (they bracket themselves with
+// FPU::KernelBegin/End, which masks IRQs, one 64KB chunk at a time);
+// small copies always use string instructions.
+// Safe to call before memory_init() (falls back to "rep movsd").
+
+extern "C" {
+    void* memcpy(void* dst, const void* src, size_t n);
+    void* memset(void* dst, int value, size_t n);
+}
+
+void memory_init(); // After CPU::Init() and FPU::Init()
+const char* memory_impl_name();
+
+// Pixel helpers (counts/pitches in 32-bit units)
+void memset32(uint32_t* dst, uint32_t value, size_t count);
+void memcpy_nt(void* dst, const void* src, size_t n); // Non-temporal stores: VRAM
+void fill_rect32(uint32_t* dst, uint32_t pitch, uint32_t width, uint32_t height, uint32_t value);
+void blit32(uint32_t* dst, uint32_t dst_pitch, const uint32_t* src, uint32_t src_pitch,
+            uint32_t width, uint32_t height);
+#endif
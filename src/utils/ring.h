@@ -0,0 +1,137 @@
+#ifndef RING_H
+#define RING_H
+#include <stdint.h>
+
+// Bounded lock-free FIFOs for handing data from interrupt context to
+// threads (or between CPUs). N must be a power of two; positions run
+// freely and are masked on use. Zero-initialised is empty, so they can be
+// globals without a constructor call.
+//
+// SpscRing: one producer, one consumer, no atomics at all.
+// MpscRing: any number of producers (IRQs on several CPUs) claim slots by
+// CAS on the tail and publish each through its sequence number; one
+// consumer.
+// "One" means one at a time: callers that share a side serialise it
+// themselves (e.g. readers under a lock). The input and keyboard queues
+// are MPSC even though each is fed by one IRQ line: that handler can run
+// on the old and the new CPU across an affinity change.
+//
+// Push fails and PushBatch stores fewer when the ring is full; nothing is
+// overwritten. Neither sleeps: waking a consumer is the caller's business.
+// The producer and consumer indices sit on cache lines of their own, so
+// the two sides don't bounce one line between CPUs.
+//
+// x86 keeps stores in order and loads in order, so a compiler barrier is
+// all that's needed between the data and the index that publishes it.
+
+#define CACHE_LINE_SIZE 64
+
+static inline void RingBarrier() { asm volatile("" : : : "memory"); }
+
+template <typename T, uint32_t N>
+class SpscRing {
+    static_assert(N && (N & (N - 1)) == 0, "ring size must be a power of two");
+
+public:
+    // Producer
+    bool Push(const T& item) { return PushBatch(&item, 1) == 1; }
+    uint32_t PushBatch(const T* items, uint32_t count) {
+        uint32_t t = tail;
+        uint32_t space = N - (t - head);
+        if (count > space) count = space;
+        RingBarrier(); // No writing into slots before seeing them free
+        for (uint32_t i = 0; i < count; i++) slots[(t + i) & (N - 1)] = items[i];
+        RingBarrier(); // Items before the index that publishes them
+        tail = t + count;
+        return count;
+    }
+
+    // Consumer
+    bool Pop(T& out) { return PopBatch(&out, 1) == 1; }
+    uint32_t PopBatch(T* out, uint32_t max) {
+        uint32_t h = head;
+        uint32_t avail = tail - h;
+        RingBarrier(); // Index before the items it covers
+        if (max > avail) max = avail;
+        for (uint32_t i = 0; i < max; i++) out[i] = slots[(h + i) & (N - 1)];
+        RingBarrier(); // Copied out before the slots are handed back
+        head = h + max;
+        return max;
+    }
+    bool Empty() const { return head == tail; }
+
+    uint32_t Size() const { return tail - head; }
+    static uint32_t Capacity() { return N; }
+
+private:
+    volatile uint32_t head __attribute__((aligned(CACHE_LINE_SIZE))); // Next to pop
+    volatile uint32_t tail __attribute__((aligned(CACHE_LINE_SIZE))); // Next to push
+    T slots[N] __attribute__((aligned(CACHE_LINE_SIZE)));
+};
+
+template <typename T, uint32_t N>
+class MpscRing {
+    static_assert(N && (N & (N - 1)) == 0, "ring size must be a power of two");
+
+public:
+    // Producers, any context. A batch takes consecutive slots: it is not
+    // interleaved with other producers' items.
+    bool Push(const T& item) { return PushBatch(&item, 1) == 1; }
+    uint32_t PushBatch(const T* items, uint32_t count) {
+        uint32_t pos, n;
+        do {
+            pos = tail;
+            // Slots below head are free: the consumer is done with them
+            int32_t used = (int32_t)(pos - head);
+            uint32_t space = used < (int32_t)N ? N - used : 0;
+            n = count < space ? count : space;
+            if (!n) return 0;
+        } while (!__sync_bool_compare_and_swap(&tail, pos, pos + n));
+
+        for (uint32_t i = 0; i < n; i++) {
+            Slot& s = slots[(pos + i) & (N - 1)];
+            s.item = items[i];
+            RingBarrier(); // Item before sequence
+            s.seq = Sequence(pos + i);
+        }
+        return n;
+    }
+
+    // Consumer. Stops at the first claimed slot not yet published, so
+    // items come out in claim order.
+    bool Pop(T& out) { return PopBatch(&out, 1) == 1; }
+    uint32_t PopBatch(T* out, uint32_t max) {
+        uint32_t h = head, n = 0;
+        while (n < max) {
+            Slot& s = slots[(h + n) & (N - 1)];
+            if (s.seq != Sequence(h + n)) break;
+            RingBarrier(); // Sequence before item
+            out[n++] = s.item;
+        }
+        RingBarrier(); // Copied out before the slots are handed back
+        head = h + n;
+        return n;
+    }
+    bool Empty() const {
+        uint32_t h = head;
+        return slots[h & (N - 1)].seq != Sequence(h);
+    }
+
+    uint32_t Size() const { return tail - head; } // Claimed, maybe not yet published
+    static uint32_t Capacity() { return N; }
+
+private:
+    // Position p is published once its slot's seq equals p + 1 - (p % N);
+    // zero-initialised slots hold nothing, and an older lap's value never
+    // matches a newer position
+    struct Slot {
+        volatile uint32_t seq;
+        T item;
+    };
+    static uint32_t Sequence(uint32_t pos) { return pos + 1 - (pos & (N - 1)); }
+
+    volatile uint32_t head __attribute__((aligned(CACHE_LINE_SIZE))); // Next to pop
+    volatile uint32_t tail __attribute__((aligned(CACHE_LINE_SIZE))); // Next to claim
+    Slot slots[N] __attribute__((aligned(CACHE_LINE_SIZE)));
+};
+#endif
@@ -0,0 +1,42 @@
+#ifndef SPINLOCK_H
+#define SPINLOCK_H
+#include <stdint.h>
+#include "../core/cpu.h"
+
+// Busy-wait lock for data shared between CPUs. Zero-initialised is unlocked.
+// Take it through SpinlockGuard, which also turns IRQs off: a handler
+// spinning on a lock its own CPU holds would wait forever. Where the hold
+// doesn't match a scope, LockIrqSave()/UnlockIrqRestore() do the same by
+// hand. A lock no handler ever takes may be held with IRQs on, by
+// Lock()/Unlock().
+struct Spinlock {
+    volatile uint32_t locked;
+
+    void Lock() {
+        while (__sync_lock_test_and_set(&locked, 1)) {
+            while (locked) asm volatile("pause");
+        }
+    }
+    bool TryLock() { return !__sync_lock_test_and_set(&locked, 1); }
+    void Unlock() { __sync_lock_release(&locked); }
+
+    uint32_t LockIrqSave() {
+        uint32_t flags = CPU::SaveAndDisableInterrupts();
+        Lock();
+        return flags;
+    }
+    void UnlockIrqRestore(uint32_t flags) {
+        Unlock();
+        CPU::RestoreInterrupts(flags);
+    }
+};
+
+class SpinlockGuard {
+public:
+    SpinlockGuard(Spinlock& l) : lock(l), flags(l.LockIrqSave()) {}
+    ~SpinlockGuard() { lock.UnlockIrqRestore(flags); }
+private:
+    Spinlock& lock;
+    uint32_t flags;
+};
+#endif